@@ -0,0 +1,234 @@
+/***********************************************************************
+*                              File: cmd.c
+*                     Copyright (c): 2019, Dan Purgert
+*                                  : dan@djph.net
+*
+*                           License: GNU GPL v2 only
+*                       Description: Device commands, mixed in with the
+*                                  : hex records on the serial line.
+*
+*                     Prerequisites:
+*                                  : avr-gcc >= 4.9.2
+*                                  : avrdude >= 6.3-2 (Debian)
+*                                  : make
+************************************************************************/
+
+/**
+ * @file
+*/
+
+#include "cmd.h"
+
+uint8_t cmdbuf[CMDSZ]; //!<Command line, less the lead byte
+uint8_t cmdlen,        //!<Bytes in cmdbuf
+        cmdpos,        //!<Parse position in cmdbuf
+        cmdovf;        //!<Line was too long for cmdbuf
+
+/**
+ * @brief Value of one hex digit, or 0xFF
+ *
+ * Unlike tohex(), this has to know a bad digit when it sees one.
+*/
+static uint8_t cmdNib(uint8_t c){
+  if (c>='0' && c<='9') {
+    return c-'0';
+  }
+  c|=0x20;
+  if (c>='a' && c<='f') {
+    return c-'a'+10;
+  }
+  return 0xFF;
+}
+
+/**
+ * @brief Next argument (1-4 hex digits) from cmdbuf
+ * Returns 0 if there isn't one.
+*/
+static uint8_t cmdArg(uint16_t *val){
+  uint8_t n=0;
+  while (cmdpos<cmdlen && cmdbuf[cmdpos]==' ') {
+    ++cmdpos;
+  }
+  *val=0;
+  while (n<4 && cmdpos<cmdlen && cmdNib(cmdbuf[cmdpos])!=0xFF) {
+    *val=(*val<<4)|cmdNib(cmdbuf[cmdpos++]);
+    ++n;
+  }
+  return n;
+}
+
+/**
+ * @brief Start / end address arguments, as an address and length
+ * The range has to be on the part, a small part would wrap around.
+*/
+static uint8_t cmdRange(uint16_t *addr, uint32_t *len){
+  uint16_t end;
+  if (!cmdArg(addr) || !cmdArg(&end) || end<*addr || end>=eesize) {
+    return 0;
+  }
+  *len=(uint32_t)end-*addr+1;
+  return 1;
+}
+
+/**
+ * @brief Anything left on the line is a bad command
+*/
+static uint8_t cmdEnd(){
+  while (cmdpos<cmdlen && cmdbuf[cmdpos]==' ') {
+    ++cmdpos;
+  }
+  return cmdpos==cmdlen;
+}
+
+/**
+ * @brief Print a byte as two hex digits (no newline)
+*/
+static void cmdHex(uint8_t data){
+  uint8_t out[2];
+  for (uint8_t i=0; i<2; i++) {
+    uint8_t nib=(i ? data : data>>4)&0x0F;
+    out[i]=(nib<10) ? ('0'+nib) : ('A'+nib-10);
+  }
+  printMsg(out,2);
+}
+
+/**
+ * @brief Send a range back as data records, then an EOF record
+*/
+static uint8_t cmdRead(uint16_t addr, uint32_t len){
+  uint8_t buf[16],
+          dev=0;
+  uint8_t fail=eeFlush();
+  while (!(EEGANG & (1<<dev))) {
+    ++dev;
+  }
+  while (len>0 && !fail) {
+    uint8_t n=(len>16) ? 16 : len,
+            sum;
+    if (!eeRead(dev,addr,buf,n)) {
+      return (1<<dev);
+    }
+    sum=n+(uint8_t)(addr>>8)+(uint8_t)addr;
+    printMsg_P(PSTR(":"));
+    cmdHex(n);
+    cmdHex(addr>>8);
+    cmdHex(addr);
+    cmdHex(0x00);
+    for (uint8_t i=0; i<n; i++) {
+      cmdHex(buf[i]);
+      sum+=buf[i];
+    }
+    cmdHex(-sum);
+    printMsg_P(PSTR("\n"));
+    addr+=n;
+    len-=n;
+  }
+  printMsg_P(PSTR(":00000001FF\n"));
+  return fail;
+}
+
+/**
+ * @brief Print the counters, part geometry and free stack
+*/
+static void cmdStats(){
+  printMsg_P(PSTR("CRC32: "));
+  printLong(eeStatCrc());
+  printMsg_P(PSTR("bytes: "));
+  printLong(eebytes);
+  printMsg_P(PSTR("pages: "));
+  printLong(eepages);
+  printMsg_P(PSTR("size: "));
+  printLong(eesize);
+  printMsg_P(PSTR("pgsz: "));
+  printLong(eedrv.pgsz);
+  printMsg_P(PSTR("stack free: "));
+  printLong(stackFree());
+}
+
+/**
+ * @brief Parse and run the command in cmdbuf
+*/
+static void cmdRun(){
+  uint16_t addr, val, bad=0;
+  uint32_t len;
+  uint8_t fail=0xFF,
+          op=cmdlen ? (cmdbuf[0]|0x20) : 0;
+  cmdpos=1;
+  if (cmdovf) {
+    op=0;
+  }
+  switch (op) {
+    case 'e': {
+      if (cmdEnd()) {
+        fail=eeErase();
+      }
+      break;
+    }
+    case 'f': {
+      if (cmdRange(&addr,&len) && cmdArg(&val) && val<=0xFF
+          && cmdEnd()) {
+        fail=eeFill(addr,len,(uint8_t)val);
+      }
+      break;
+    }
+    case 'r': {
+      if (cmdRange(&addr,&len) && cmdEnd()) {
+        fail=cmdRead(addr,len);
+      }
+      break;
+    }
+    case 'v': {
+      if (cmdRange(&addr,&len) && cmdArg(&val) && val<=0xFF
+          && cmdEnd()) {
+        fail=eeVerify(addr,len,(uint8_t)val,&bad);
+      }
+      break;
+    }
+    case 's': {
+      if (cmdEnd()) {
+        cmdStats();
+        fail=0;
+      }
+      break;
+    }
+    case 'b': {
+      if (cmdArg(&val) && cmdEnd()) {
+        printMsg_P(PSTR("OK\n"));
+        //host needs to see the OK at the old rate
+        txDrain();
+        initUSART(val);
+        return;
+      }
+      break;
+    }
+    default: {
+      break;
+    }
+  }
+  if (fail) {
+    printMsg_P(PSTR("ERR "));
+    printAscii(fail);
+    if (op=='v' && fail!=0xFF) {
+      printLong(bad);
+    }
+  }
+  else {
+    printMsg_P(PSTR("OK\n"));
+  }
+}
+
+uint8_t cmdByte(uint8_t bt){
+  if (bt==0x0A || bt==0x0D) {
+    cmdRun();
+    cmdlen=0;
+    cmdovf=0;
+    return 1;
+  }
+  if (cmdlen<CMDSZ) {
+    cmdbuf[cmdlen++]=bt;
+  }
+  else {
+    cmdovf=1;
+  }
+  return 0;
+}
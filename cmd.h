@@ -0,0 +1,64 @@
+/***********************************************************************
+*                              File: cmd.h
+*                     Copyright (c): 2019, Dan Purgert
+*                                  : dan@djph.net
+*
+*                           License: GNU GPL v2 only
+*                       Description: Device commands, mixed in with the
+*                                  : hex records on the serial line.
+*
+*                     Prerequisites:
+*                                  : avr-gcc >= 4.9.2
+*                                  : avrdude >= 6.3-2 (Debian)
+*                                  : make
+************************************************************************/
+
+/**
+ * @file
+ * @brief Command layer header
+ *
+ * A line starting with '!' (where a ':' would start a record) is a
+ * command rather than a hex record.  It runs on the device at bus
+ * speed, so clearing a part doesn't mean sending a hex file full of
+ * 0xFF.  Arguments are hex, optionally separated by spaces, ranges are
+ * start and end address (inclusive) and have to fit on the part
+ * (eesize), values (vv) are one byte, and the line ends with CR or LF:
+ *
+ *  - !E               erase every part in the gang
+ *  - !F ssss eeee vv  fill ssss..eeee with vv
+ *  - !R ssss eeee     read ssss..eeee (first part in the gang), sent
+ *                     back as hex records
+ *  - !V ssss eeee vv  verify ssss..eeee holds vv on every part
+ *  - !S               stats: image CRC32 / bytes / pages so far, part
+ *                     size, page size, free stack
+ *  - !B uuuu          set UBRR to uuuu, after the reply has gone out
+ *
+ * Every command finishes with "OK", or "ERR" and a mask of the parts
+ * that failed (FF for a bad command line).  After a verify failure the
+ * first mismatching address follows (the start of the range if a part
+ * failed before anything was compared).
+*/
+
+#ifndef __HEX_CMD__
+  #define __HEX_CMD__ 1
+  #include "common.h"
+
+  /**
+   * @brief Lead byte for a command
+  */
+  #define CMDLEAD '!'
+  /**
+   * @brief Longest command line (not counting the lead byte)
+  */
+  #define CMDSZ 20
+
+  /**
+   * @brief Feed one byte of a command line
+   *
+   * Called for each byte after CMDLEAD.  Returns 1 once the line end
+   * has come in and the command has been run, 0 while it's still
+   * collecting.
+  */
+  uint8_t cmdByte(uint8_t bt);
+
+#endif
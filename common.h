@@ -29,9 +29,15 @@
 
   #include <avr/io.h>
   #include <avr/interrupt.h>
+  #include <avr/pgmspace.h>
   #include <stdint.h>
   #include "main.h"
   #include "usart.h"
+  #include "twi.h"
+  #include "spi.h"
+  #include "eeprom.h"
+  #include "mem.h"
+  #include "cmd.h"
 
 #endif
 
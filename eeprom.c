@@ -0,0 +1,415 @@
+/***********************************************************************
+*                              File: eeprom.c
+*                     Copyright (c): 2019, Dan Purgert
+*                                  : dan@djph.net
+*
+*                           License: GNU GPL v2 only
+*                       Description: EEPROM page writes, including
+*                                  : "gang" programming of several parts
+*                                  : sharing one bus.  The bus specifics
+*                                  : live in a storage backend.
+*
+*                     Prerequisites:
+*                                  : avr-gcc >= 4.9.2
+*                                  : avrdude >= 6.3-2 (Debian)
+*                                  : make
+************************************************************************/
+
+/**
+ * @file
+*/
+
+#include "eeprom.h"
+#include <util/delay.h>
+
+uint8_t eebusy; //!<Bit n set if part n has a write cycle in progress
+uint32_t eesize;
+uint16_t eetmo;
+uint32_t eecrc;
+uint32_t eebytes;
+uint16_t eepages;
+uint8_t pgbuf[PGMAX]; //!<Page buffer, data waiting to be written out
+uint16_t pgadr; //!<EEPROM address of pgbuf[0]
+uint8_t pglen; //!<Bytes waiting in pgbuf
+
+/**
+ * @brief Known parts
+ *
+ * The 24Cxx and 25xx families line up, so one table does for both.
+ * Serial flash says how big it is (eedrv.ident()), and gets its own
+ * entries.  Sorted by capacity, which is all the probe can tell parts
+ * of one kind apart by.
+*/
+const struct eePart eeparts[] PROGMEM = {
+  //   kB pgsz twr flash
+  {    4,  32, 10, 0}, //24C32  / 25xx320
+  {    8,  32,  5, 0}, //24C64  / 25xx640
+  {   16,  64,  5, 0}, //24C128 / 25xx128
+  {   32,  64,  5, 0}, //24C256 / 25xx256
+  {   64, 128,  5, 0}, //24C512 / 25xx512
+  {   64, 256,  5, 1}, //25X05
+  {  128, 256,  5, 1}, //25X10
+  {  256, 256,  5, 1}, //25X20
+  {  512, 256,  5, 1}, //25X40
+  { 1024, 256,  5, 1}, //25X80  / 25Q80
+  { 2048, 256,  5, 1}, //25Q16
+  { 4096, 256,  5, 1}, //25Q32
+  { 8192, 256,  5, 1}, //25Q64
+  {16384, 256,  5, 1}, //25Q128
+};
+#define EENPARTS (sizeof(eeparts)/sizeof(eeparts[0]))
+
+void initEEPROM(){
+  eedrv.init();
+  eebusy=0;
+  pglen=0;
+  if (eedrv.pgsz>PGMAX) {
+    //writing part of a page at a time is fine, just slower
+    eedrv.pgsz=PGMAX;
+  }
+  eesize=65536UL;
+  eetmo=EETWR*(2000/EEPOLL);
+  eeStatClr();
+}
+
+void eeStatClr(){
+  eecrc=0xFFFFFFFFUL;
+  eebytes=0;
+  eepages=0;
+}
+
+uint32_t eeStatCrc(){
+  return ~eecrc;
+}
+
+uint32_t crc32(uint32_t crc, uint8_t data){
+  crc ^= data;
+  for (uint8_t i=0; i<8; i++) {
+    if (crc & 1) {
+      crc=(crc>>1)^0xEDB88320UL;
+    }
+    else {
+      crc>>=1;
+    }
+  }
+  return crc;
+}
+
+void eePartInfo(uint8_t idx, struct eePart *part){
+  part->kb=pgm_read_word(&eeparts[idx].kb);
+  part->pgsz=pgm_read_word(&eeparts[idx].pgsz);
+  part->twr=pgm_read_byte(&eeparts[idx].twr);
+  part->flash=pgm_read_byte(&eeparts[idx].flash);
+}
+
+/**
+ * @brief Write one byte and wait for it to land
+*/
+static uint8_t eePoke(uint8_t dev, uint16_t addr, uint8_t data){
+  return eeWrite(dev,addr,&data,1) && eeWait(dev);
+}
+
+/**
+ * @brief Measure capacity (kbytes) and page size of one part
+ * Returns 0 if the part didn't answer, or made no sense.  Either way
+ * its first PGMAX bytes are put back as they were, if it lets us.
+*/
+static uint8_t eeProbeDev(uint8_t dev, uint16_t *kb, uint8_t *pg){
+  uint8_t save[PGMAX],
+          b=0,
+          ok=1;
+  //present?  Pretend it's busy, so eeWait() goes and polls it.
+  eebusy |= (1<<dev);
+  if (!eeWait(dev)) {
+    return 0;
+  }
+  if (eedrv.ident) {
+    //flash bits only go one way, so it can't be measured by writing to
+    //it.  It tells us its size instead, the table has the page size.
+    uint8_t n=eedrv.ident(dev);
+    if (n==0) {
+      return 0;
+    }
+    *kb=(n>=10 && n<=24) ? (1U<<(n-10)) : 64;
+    *pg=PGMAX;
+    return 1;
+  }
+  //the probe only ever writes the first PGMAX bytes, keep them
+  if (!eeRead(dev,0,save,PGMAX)) {
+    return 0;
+  }
+  //capacity.  Two different markers, so a byte that just happens to
+  //match doesn't count as a wrap.
+  *kb=64;
+  for (uint8_t k=4; ok && k<64; k<<=1) {
+    uint8_t hit=0;
+    for (uint8_t j=0; ok && j<2; j++) {
+      uint8_t m=(j ? 0x5A : 0xA5);
+      ok=eePoke(dev,0,m) && eeRead(dev,(uint16_t)k<<10,&b,1);
+      hit+=(b==m);
+    }
+    if (hit==2) {
+      *kb=k;
+      break;
+    }
+  }
+  //page size.  Byte 0 ends up holding the last value written to it,
+  //which is PGMAX - page size.
+  if (ok) {
+    for (uint8_t i=0; i<PGMAX; i++) {
+      pgbuf[i]=i;
+    }
+    ok=eeWrite(dev,0,pgbuf,PGMAX) && eeWait(dev) && eeRead(dev,0,&b,1);
+  }
+  *pg=PGMAX-b;
+  if (!ok || b>=PGMAX || (*pg & (*pg-1))) {
+    //no idea how big a page is, so put things back a byte at a time
+    ok=0;
+    *pg=1;
+  }
+  for (uint8_t a=0; a<PGMAX; a+=*pg) {
+    if (!eeWrite(dev,a,save+a,*pg) || !eeWait(dev)) {
+      return 0;
+    }
+  }
+  return ok;
+}
+
+uint8_t eeProbe(){
+  uint16_t kb=0xFFFF;
+  uint8_t pg=PGMAX,
+          idx=EENPARTS,
+          twr=EETWR,
+          flash=(eedrv.ident!=0);
+  struct eePart part;
+  for (uint8_t dev=0; dev<8; dev++) {
+    uint16_t dkb;
+    uint8_t dpg;
+    if (!(EEGANG & (1<<dev))) {
+      continue;
+    }
+    if (!eeProbeDev(dev,&dkb,&dpg)) {
+      return EENOPART;
+    }
+    if (dkb<kb) {
+      kb=dkb;
+    }
+    if (dpg<pg) {
+      pg=dpg;
+    }
+  }
+  for (uint8_t i=0; i<EENPARTS; i++) {
+    eePartInfo(i,&part);
+    if (part.kb==kb && part.flash==flash) {
+      idx=i;
+      twr=part.twr;
+      //a page that's too big corrupts data, too small only costs time
+      if (part.pgsz<pg) {
+        pg=part.pgsz;
+      }
+      break;
+    }
+  }
+  eedrv.pgsz=pg;
+  //addresses are 16 bit, anything past 64k can't be reached
+  eesize=(kb>64) ? 65536UL : (uint32_t)kb<<10;
+  eetmo=twr*(2000/EEPOLL);
+  return idx;
+}
+
+uint8_t eeWait(uint8_t dev){
+  uint8_t bit=(1<<dev);
+  if (!(eebusy & bit)) {
+    return 1;
+  }
+  //poll at EEPOLL intervals, eetmo allows twice the write cycle time
+  for (uint16_t i=0; i<eetmo; i++) {
+    if (!eedrv.busy(dev)) {
+      eebusy &= ~bit;
+      return 1;
+    }
+    _delay_us(EEPOLL);
+  }
+  return 0;
+}
+
+uint8_t eeWrite(uint8_t dev, uint16_t addr, uint8_t *data, uint8_t len){
+  uint8_t ok=eedrv.write(dev,addr,data,len);
+  if (ok) {
+    eebusy |= (1<<dev);
+  }
+  return ok;
+}
+
+uint8_t eeRead(uint8_t dev, uint16_t addr, uint8_t *data, uint8_t len){
+  if (!eeWait(dev)) {
+    return 0;
+  }
+  return eedrv.read(dev,addr,data,len);
+}
+
+/**
+ * @brief Write (part of) one page to every part in the gang
+*/
+static uint8_t eeGang(uint16_t addr, uint8_t *data, uint8_t len){
+  uint8_t fail=0;
+  for (uint8_t dev=0; dev<8; dev++) {
+    if (!(EEGANG & (1<<dev))) {
+      continue;
+    }
+    if (!eeWait(dev) || !eeWrite(dev,addr,data,len)) {
+      fail |= (1<<dev);
+    }
+  }
+  return fail;
+}
+
+/**
+ * @brief Write the page buffer out to every part in the gang
+*/
+static uint8_t eePut(){
+  uint8_t fail=eeGang(pgadr,pgbuf,pglen);
+  ++eepages;
+  pglen=0;
+  return fail;
+}
+
+uint8_t eeCommit(uint16_t addr, uint8_t *data, uint8_t len){
+  uint8_t fail=0;
+  if ((uint32_t)addr+len > eesize) {
+    //would wrap around and land on the start of the part
+    return EEGANG;
+  }
+  while (len>0) {
+    if (pglen>0 && addr!=(uint16_t)(pgadr+pglen)) {
+      //not contiguous with what's buffered, write that out first
+      fail |= eePut();
+    }
+    if (pglen==0) {
+      pgadr=addr;
+    }
+    //don't run past the end of the page, the part would wrap around
+    uint16_t n=eedrv.pgsz-(addr%eedrv.pgsz);
+    if (n>len) {
+      n=len;
+    }
+    for (uint8_t i=0; i<n; i++) {
+      pgbuf[pglen++]=data[i];
+      eecrc=crc32(eecrc,data[i]);
+    }
+    eebytes+=n;
+    addr+=n;
+    data+=n;
+    len-=n;
+    if ((addr%eedrv.pgsz)==0) {
+      //page is full
+      fail |= eePut();
+    }
+  }
+  return fail;
+}
+
+uint8_t eeFlush(){
+  uint8_t fail=0;
+  if (pglen>0) {
+    fail=eePut();
+  }
+  for (uint8_t dev=0; dev<8; dev++) {
+    if ((EEGANG & (1<<dev)) && !eeWait(dev)) {
+      fail |= (1<<dev);
+    }
+  }
+  return fail;
+}
+
+uint8_t eeFill(uint16_t addr, uint32_t len, uint8_t val){
+  uint8_t fail=eeFlush();
+  if ((uint32_t)addr+len > eesize) {
+    return EEGANG;
+  }
+  for (uint8_t i=0; i<PGMAX; i++) {
+    pgbuf[i]=val;
+  }
+  while (len>0 && !fail) {
+    uint16_t n=eedrv.pgsz-(addr%eedrv.pgsz);
+    if (n>len) {
+      n=len;
+    }
+    fail |= eeGang(addr,pgbuf,n);
+    addr+=n;
+    len-=n;
+  }
+  return fail|eeFlush();
+}
+
+uint8_t eeErase(){
+  uint8_t fail=eeFlush(),
+          wait=0;
+  for (uint8_t dev=0; dev<8; dev++) {
+    uint8_t bit=(1<<dev);
+    if (!(EEGANG & bit) || (fail & bit)) {
+      continue;
+    }
+    if (!eedrv.erase(dev)) {
+      //no erase command, do it the slow way (all of the gang at once)
+      return fail|eeFill(0,eesize,0xFF);
+    }
+    eebusy |= bit;
+    wait |= bit;
+  }
+  //the whole gang erases at once, poll them together.  A part that
+  //never finishes stays marked busy, so nothing gets written to it.
+  for (uint32_t ms=0; wait && ms<EEERASE*1000UL; ms++) {
+    for (uint8_t dev=0; dev<8; dev++) {
+      uint8_t bit=(1<<dev);
+      if ((wait & bit) && !eedrv.busy(dev)) {
+        wait &= ~bit;
+        eebusy &= ~bit;
+      }
+    }
+    if (wait) {
+      _delay_ms(1);
+    }
+  }
+  return fail|wait;
+}
+
+uint8_t eeVerify(uint16_t addr, uint32_t len, uint8_t val,
+                 uint16_t *bad){
+  uint8_t fail,
+          mis=0;
+  //nothing compared yet
+  *bad=addr;
+  if ((uint32_t)addr+len > eesize) {
+    return EEGANG;
+  }
+  fail=eeFlush();
+  for (uint8_t dev=0; dev<8; dev++) {
+    uint8_t bit=(1<<dev);
+    uint16_t a=addr;
+    uint32_t left=len;
+    if (!(EEGANG & bit)) {
+      continue;
+    }
+    while (left>0 && !(fail & bit)) {
+      uint8_t n=(left>PGMAX) ? PGMAX : left;
+      if (!eeRead(dev,a,pgbuf,n)) {
+        fail |= bit;
+        break;
+      }
+      for (uint8_t i=0; i<n; i++) {
+        if (pgbuf[i]!=val) {
+          if (!mis || a+i<*bad) {
+            *bad=a+i;
+          }
+          mis=1;
+          fail |= bit;
+          break;
+        }
+      }
+      a+=n;
+      left-=n;
+    }
+  }
+  return fail;
+}
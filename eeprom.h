@@ -0,0 +1,274 @@
+/***********************************************************************
+*                              File: eeprom.h
+*                     Copyright (c): 2019, Dan Purgert
+*                                  : dan@djph.net
+*
+*                           License: GNU GPL v2 only
+*                       Description: EEPROM page writes, including
+*                                  : "gang" programming of several parts
+*                                  : sharing one bus.  The bus specifics
+*                                  : live in a storage backend.
+*
+*                     Prerequisites:
+*                                  : avr-gcc >= 4.9.2
+*                                  : avrdude >= 6.3-2 (Debian)
+*                                  : make
+************************************************************************/
+
+/**
+ * @file
+ * @brief EEPROM control header
+ *
+ * The page layer here only knows about pages and parts; talking to a
+ * part is done through a storage backend (struct eeDrv).  Exactly one
+ * backend is linked in, picked by STORE in the makefile:
+ *  - twiee.c: 24xx TWI EEPROM (default)
+ *  - spiee.c: 25xx SPI EEPROM / serial NOR flash
+ *
+ * Every verified data record is committed to each part in the gang.
+ * Writes are interleaved: a page goes to part 0, then part 1, and so
+ * on, and we only come back to poll part 0 when it's time for its
+ * next page.  That way one part's internal write cycle (~5ms) overlaps
+ * with bus traffic to the others, rather than each part being
+ * programmed start to finish on its own.
+*/
+
+#ifndef __HEX_EEPROM__
+  #define __HEX_EEPROM__ 1
+  #include "common.h"
+
+  /**
+   * @brief Gang mask.
+   *
+   * Bit n set means there's a part at device number n.  What that means
+   * depends on the backend (A2..A0 strapping for TWI, chip select line
+   * for SPI).  Default is just the one part, device 0.
+  */
+  #ifndef EEGANG
+    #define EEGANG 0x01
+  #endif
+  /**
+   * @brief Busy poll interval (us)
+  */
+  #define EEPOLL 100
+  /**
+   * @brief Default write cycle time (ms)
+   *
+   * Used until a part has been probed, or if it isn't in the part
+   * table.  10ms covers the slowest 24xx / 25xx parts around.
+  */
+  #define EETWR 10
+  /**
+   * @brief Longest we'll wait on a whole-part erase (s)
+   *
+   * Datasheet maximum for the biggest flash in the part table (25Q128,
+   * 200s).  The gang erases together, so this is the wait for all of
+   * them, not each.
+  */
+  #define EEERASE 200
+  /**
+   * @brief No part found (see eeProbe())
+  */
+  #define EENOPART 0xFF
+
+  /**
+   * @brief Part table entry
+   *
+   * The table itself (eeparts[]) lives in flash.  Only two address byte
+   * EEPROMs are listed, smaller ones use a different addressing scheme.
+  */
+  struct eePart {
+    uint16_t kb;   //!<Capacity in kbytes
+    uint16_t pgsz; //!<Page size in bytes
+    uint8_t twr;   //!<Worst case write (page program) time in ms
+    uint8_t flash; //!<Serial flash, found by eedrv.ident()
+  };
+
+  /**
+   * @brief Storage backend
+   *
+   * Everything the page layer needs to know about a part.  dev is the
+   * device number (0-7) of one part in the gang.  None of the calls
+   * wait on a write cycle; that's what busy() is for.
+  */
+  struct eeDrv {
+    uint16_t pgsz; //!<Page size in bytes, eeProbe() may lower it
+    /**
+     * @brief Bring up the bus
+    */
+    void (*init)();
+    /**
+     * @brief Poll once, returns 1 if dev is still in a write cycle
+    */
+    uint8_t (*busy)(uint8_t dev);
+    /**
+     * @brief Start a write of len bytes at addr, all within one page
+     * Returns 1 if the part accepted it.
+    */
+    uint8_t (*write)(uint8_t dev, uint16_t addr, uint8_t *data,
+                     uint8_t len);
+    /**
+     * @brief Read len bytes starting at addr
+     * Returns 1 if the part answered.
+    */
+    uint8_t (*read)(uint8_t dev, uint16_t addr, uint8_t *data,
+                    uint8_t len);
+    /**
+     * @brief Start a whole-part erase
+     * Returns 0 if the part has no erase command.
+    */
+    uint8_t (*erase)(uint8_t dev);
+    /**
+     * @brief Read the part's ID, for parts that can't be probed
+     *
+     * Serial flash only (NULL otherwise).  Returns the capacity as
+     * log2(bytes), from the JEDEC ID, or 0 if nothing answered.
+    */
+    uint8_t (*ident)(uint8_t dev);
+  };
+  /**
+   * @brief The backend linked into this build
+  */
+  extern struct eeDrv eedrv;
+
+  /**
+   * @brief Capacity of the part(s), in bytes
+  */
+  extern uint32_t eesize;
+  /**
+   * @brief Busy polls before we give up on a write cycle
+  */
+  extern uint16_t eetmo;
+  /**
+   * @brief Running CRC32 of every byte committed since eeStatClr()
+   *
+   * Bytes are taken in the order they're committed, i.e. file order.
+   * That's only address order if every record starts above the last
+   * one; host/hexcrc warns when it doesn't, and refuses overlapping
+   * records.  Standard (zlib / IEEE 802.3) CRC32, with the final
+   * inversion still to be done, see eeStatCrc().
+  */
+  extern uint32_t eecrc;
+  /**
+   * @brief Bytes committed since eeStatClr()
+  */
+  extern uint32_t eebytes;
+  /**
+   * @brief Page writes since eeStatClr(), counted once per gang write
+  */
+  extern uint16_t eepages;
+
+  /**
+   * @brief Initialize EEPROM(s)
+   * Bring up the backend, and mark every part in the gang idle.
+   * Geometry is set to the defaults (PGSZ, 64k, EETWR) until probed.
+  */
+  void initEEPROM();
+  /**
+   * @brief Work out what's connected
+   *
+   * Checks every part in the gang answers, then finds its capacity (by
+   * toggling byte 0 and watching for it to show up again at 4k, 8k,
+   * ... where the address wraps around) and page size (by writing
+   * PGMAX bytes in one go and seeing where the part wrapped them to).
+   * The result is matched against the part table, and the gang runs at
+   * the smallest geometry found.
+   *
+   * The first PGMAX bytes of each EEPROM are read beforehand and
+   * written back afterwards, a page at a time, so what's on the part
+   * survives (short of losing power part way through).  That takes a
+   * PGMAX byte buffer on the stack.  Serial flash (eedrv.ident set) is
+   * never written; its capacity comes from its ID, and its page size
+   * from the table.  Parts over 64k are used as 64k parts, record
+   * addresses being 16 bit.
+   *
+   * Returns the part table index, EENOPART if a part is missing, or
+   * the table size if the geometry didn't match anything in the table
+   * (the measured geometry is used anyway).
+  */
+  uint8_t eeProbe();
+  /**
+   * @brief Look up a part table entry (in flash)
+  */
+  void eePartInfo(uint8_t idx, struct eePart *part);
+  /**
+   * @brief Wait for a part to finish its write cycle
+   *
+   * Polls part dev if we've left it busy.  Returns 1 once the part is
+   * idle, or 0 if it never was within eetmo polls.
+  */
+  uint8_t eeWait(uint8_t dev);
+  /**
+   * @brief Write (part of) one page to one part
+   *
+   * Starts the write cycle, then returns without waiting for it.  The
+   * caller must keep the data within a single page, as the part will
+   * wrap around to the start of the page otherwise.  Returns 1 if the
+   * part accepted the data.
+  */
+  uint8_t eeWrite(uint8_t dev, uint16_t addr, uint8_t *data, uint8_t len);
+  /**
+   * @brief Read from one part
+   * Returns 1 if the part answered.
+  */
+  uint8_t eeRead(uint8_t dev, uint16_t addr, uint8_t *data, uint8_t len);
+  /**
+   * @brief Commit data to every part in the gang
+   *
+   * Data is gathered in a page buffer, so consecutive records that land
+   * in the same page share a single write cycle.  When the buffer hits
+   * the end of a page, or the next record isn't contiguous with it, the
+   * buffer is written to every part in EEGANG in turn.  Returns a mask
+   * of parts that failed (timed out or NAKed), so 0 means all is well.
+  */
+  uint8_t eeCommit(uint16_t addr, uint8_t *data, uint8_t len);
+  /**
+   * @brief Write out the page buffer, and wait for the gang to go idle
+   * Returns a mask of parts that failed.
+  */
+  uint8_t eeFlush();
+  /**
+   * @brief Fill len bytes from addr with val, on every part in the gang
+   *
+   * Writes whole pages straight from a buffer of val, so it runs at bus
+   * speed.  Anything still in the page buffer is written out first.
+   * Doesn't touch the CRC / byte / page counters.  Returns a mask of
+   * parts that failed.
+  */
+  uint8_t eeFill(uint16_t addr, uint32_t len, uint8_t val);
+  /**
+   * @brief Erase every part in the gang
+   *
+   * Uses the part's own erase command where it has one (serial flash),
+   * starting it on every part before waiting on any, otherwise fills
+   * the whole part with 0xFF.  Returns a mask of parts that failed; one
+   * that's still erasing is left busy, so eeWait() keeps polling it.
+  */
+  uint8_t eeErase();
+  /**
+   * @brief Check len bytes from addr hold val, on every part in the gang
+   *
+   * Returns a mask of parts that didn't (or didn't answer), all of
+   * them if the range runs past eesize.  *bad is set to the lowest
+   * address that didn't match on any part, or to addr if no mismatch
+   * was found (a part failed before it could be compared).
+  */
+  uint8_t eeVerify(uint16_t addr, uint32_t len, uint8_t val,
+                   uint16_t *bad);
+  /**
+   * @brief Reset the CRC / byte / page counters for a new image
+  */
+  void eeStatClr();
+  /**
+   * @brief Finished CRC32 of the image so far
+  */
+  uint32_t eeStatCrc();
+  /**
+   * @brief Add a byte to a CRC32
+   *
+   * Bitwise, no table; it's 8 shifts a byte, which is nothing next to
+   * the time it takes the byte to come in over the serial line.
+  */
+  uint32_t crc32(uint32_t crc, uint8_t data);
+
+#endif
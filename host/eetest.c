@@ -0,0 +1,403 @@
+/***********************************************************************
+*                              File: eetest.c
+*                     Copyright (c): 2019, Dan Purgert
+*                                  : dan@djph.net
+*
+*                           License: GNU GPL v2 only
+*                       Description: Host side test of the EEPROM page
+*                                  : layer (eeprom.c), against a mock
+*                                  : storage backend.
+*
+*                     Prerequisites:
+*                                  : cc (any C99 compiler)
+*                                  : make
+************************************************************************/
+
+/**
+ * @file
+ * @brief Page layer tests
+ *
+ * Usage: eetest (or "make check")
+ *
+ * eeprom.c is built as is, with host/sim standing in for the AVR
+ * headers, and the backend (eedrv) is a mock gang of parts kept in
+ * memory.  A mock part behaves like a 24xx: it NAKs while it's in a
+ * write cycle, and a write that runs off the end of a page wraps back
+ * to the start of it.  Time only moves when the page layer delays, so
+ * write cycles and timeouts come out the same on every run.
+ *
+ * Built with EEGANG=0x0B (parts 0, 1 and 3), so part 2 must never be
+ * touched.  Prints each failed check and exits 1 if there were any.
+*/
+
+#include "eeprom.h"
+#include <stdio.h>
+#include <string.h>
+
+#if EEGANG != 0x0B
+  #error "eetest expects EEGANG=0x0B"
+#endif
+
+#define MOCKTWR 5000 //!<Mock write cycle (us)
+
+/**
+ * @brief One mock part
+*/
+struct mockPart {
+  uint8_t mem[65536];
+  uint32_t size;   //!<Capacity, addresses wrap around at this
+  uint16_t pgsz;   //!<Page size, writes wrap around inside a page
+  uint32_t busyto; //!<simus when the write cycle is over
+  int nak;         //!<Doesn't answer at all
+  int absent;      //!<Not fitted, on a bus with no acks (SPI, see below)
+  int stuck;       //!<Never finishes a write cycle
+  uint8_t id;      //!<Capacity code from the ID (flash), see mockIdent()
+  int writes;      //!<Writes accepted
+  int split;       //!<Writes that ran off the end of a page
+};
+
+uint32_t simus;
+struct mockPart part[8];
+int fails;
+
+#define CHECK(c) do { \
+    if (!(c)) { \
+      printf("%s:%d: %s\n",__FILE__,__LINE__,#c); \
+      ++fails; \
+    } \
+  } while (0)
+
+static void mockInit(){
+}
+
+/*
+ * An absent SPI part: writes and reads "work" (nothing can say they
+ * didn't), MISO is pulled up, so reads give 0xFF and RDSR shows WIP.
+*/
+static uint8_t mockBusy(uint8_t dev){
+  struct mockPart *p=&part[dev];
+  return p->nak || p->absent || simus<p->busyto;
+}
+
+static uint8_t mockWrite(uint8_t dev, uint16_t addr, uint8_t *data,
+                         uint8_t len){
+  struct mockPart *p=&part[dev];
+  if (p->absent) {
+    return 1;
+  }
+  if (mockBusy(dev)) {
+    return 0;
+  }
+  uint32_t pg=addr-(addr%p->pgsz);
+  if ((addr%p->pgsz)+len>p->pgsz) {
+    ++p->split;
+  }
+  for (uint8_t i=0; i<len; i++) {
+    p->mem[(pg+(addr-pg+i)%p->pgsz)%p->size]=data[i];
+  }
+  ++p->writes;
+  p->busyto=p->stuck ? 0xFFFFFFFFUL : simus+MOCKTWR;
+  return 1;
+}
+
+static uint8_t mockRead(uint8_t dev, uint16_t addr, uint8_t *data,
+                        uint8_t len){
+  struct mockPart *p=&part[dev];
+  if (p->absent) {
+    memset(data,0xFF,len);
+    return 1;
+  }
+  if (mockBusy(dev)) {
+    return 0;
+  }
+  for (uint8_t i=0; i<len; i++) {
+    data[i]=p->mem[((uint32_t)addr+i)%p->size];
+  }
+  return 1;
+}
+
+uint32_t mocktce; //!<Mock chip erase time (us), 0 for no CE command
+
+static uint8_t mockErase(uint8_t dev){
+  struct mockPart *p=&part[dev];
+  if (!mocktce) {
+    return 0;
+  }
+  memset(p->mem,0xFF,sizeof(p->mem));
+  p->busyto=p->stuck ? 0xFFFFFFFFUL : simus+mocktce;
+  return 1;
+}
+
+static uint8_t mockIdent(uint8_t dev){
+  return part[dev].nak ? 0 : part[dev].id;
+}
+
+struct eeDrv eedrv = {
+  PGSZ,
+  mockInit,
+  mockBusy,
+  mockWrite,
+  mockRead,
+  mockErase,
+  0,
+};
+
+/**
+ * @brief Fresh (erased, idle) 64k parts with pgsz byte pages
+*/
+static void reset(uint16_t pgsz){
+  memset(part,0,sizeof(part));
+  for (int i=0; i<8; i++) {
+    memset(part[i].mem,0xFF,sizeof(part[i].mem));
+    part[i].size=65536;
+    part[i].pgsz=pgsz;
+  }
+  simus=0;
+  mocktce=0;
+  eedrv.ident=0;
+  initEEPROM();
+  eedrv.pgsz=pgsz;
+}
+
+/**
+ * @brief Does every part in the gang hold len bytes of data at addr?
+*/
+static int holds(uint16_t addr, const uint8_t *data, uint16_t len){
+  for (int dev=0; dev<8; dev++) {
+    if ((EEGANG & (1<<dev))
+        && memcmp(part[dev].mem+addr,data,len)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static void testSplit(){
+  uint8_t rec[16];
+  for (int i=0; i<16; i++) {
+    rec[i]=0x30+i;
+  }
+  reset(32);
+  //0x1C..0x2B crosses the 0x20 page boundary
+  CHECK(eeCommit(0x001C,rec,16)==0);
+  CHECK(eeFlush()==0);
+  CHECK(holds(0x001C,rec,16));
+  for (int dev=0; dev<8; dev++) {
+    CHECK(part[dev].split==0);
+  }
+  CHECK(part[0].writes==2 && part[1].writes==2 && part[3].writes==2);
+  CHECK(part[2].writes==0);
+  CHECK(eepages==2 && eebytes==16);
+}
+
+static void testCoalesce(){
+  uint8_t rec[16];
+  reset(64);
+  //20 contiguous 16 byte records fill five 64 byte pages
+  for (int r=0; r<20; r++) {
+    for (int i=0; i<16; i++) {
+      rec[i]=r*16+i;
+    }
+    CHECK(eeCommit(r*16,rec,16)==0);
+  }
+  CHECK(eeFlush()==0);
+  CHECK(part[0].writes==5 && part[1].writes==5 && part[3].writes==5);
+  CHECK(eepages==5 && eebytes==320);
+  for (int i=0; i<320; i++) {
+    CHECK(part[3].mem[i]==(uint8_t)i);
+  }
+  //a gap in the same page still costs a separate write
+  reset(64);
+  CHECK(eeCommit(0x0100,rec,4)==0);
+  CHECK(eeCommit(0x0110,rec,4)==0);
+  CHECK(eeFlush()==0);
+  CHECK(part[0].writes==2 && eepages==2);
+  CHECK(holds(0x0100,rec,4) && holds(0x0110,rec,4));
+  CHECK(part[0].mem[0x0104]==0xFF);
+}
+
+static void testInterleave(){
+  uint8_t rec[32];
+  memset(rec,0xA5,sizeof(rec));
+  reset(32);
+  //eight pages to three parts: each part's write cycles overlap the
+  //others', so this takes about eight write cycles, not 24
+  for (int pg=0; pg<8; pg++) {
+    CHECK(eeCommit(pg*32,rec,32)==0);
+  }
+  CHECK(eeFlush()==0);
+  CHECK(part[0].writes==8 && part[1].writes==8 && part[3].writes==8);
+  CHECK(simus>=8UL*MOCKTWR && simus<=9UL*MOCKTWR);
+}
+
+static void testFailMask(){
+  uint8_t rec[8]={1,2,3,4,5,6,7,8};
+  //part 1 isn't there
+  reset(32);
+  part[1].nak=1;
+  CHECK(eeCommit(0x0040,rec,8)==0);
+  CHECK(eeFlush()==0x02);
+  CHECK(!memcmp(part[0].mem+0x0040,rec,8));
+  CHECK(!memcmp(part[3].mem+0x0040,rec,8));
+  CHECK(part[1].writes==0);
+  //part 3 takes the data but never comes out of its write cycle
+  reset(32);
+  part[3].stuck=1;
+  CHECK(eeCommit(0x0040,rec,8)==0);
+  CHECK(eeFlush()==0x08);
+  CHECK(holds(0x0040,rec,8));
+  //and gave up after eetmo polls, twice the write cycle (once parts
+  //0 and 1 were done)
+  CHECK(simus>=2000UL*EETWR+MOCKTWR
+        && simus<=2000UL*EETWR+MOCKTWR+EEPOLL);
+  //the next page can't go to it, the others still get it
+  CHECK(eeCommit(0x0080,rec,8)==0);
+  CHECK(eeFlush()==0x08);
+  CHECK(!memcmp(part[0].mem+0x0080,rec,8));
+  CHECK(part[3].mem[0x0080]==0xFF);
+}
+
+static void testRange(){
+  uint8_t rec[16]={0};
+  reset(32);
+  eesize=4096;
+  //would wrap to the start of a 4k part
+  CHECK(eeCommit(0x0FF8,rec,16)==EEGANG);
+  CHECK(eeCommit(0x0FF0,rec,16)==0);
+  CHECK(eeFlush()==0);
+  CHECK(part[0].mem[0x0000]==0xFF);
+}
+
+static void testCrc(){
+  //the standard CRC32 check value
+  reset(32);
+  CHECK(eeCommit(0x0000,(uint8_t *)"123456789",9)==0);
+  CHECK(eeStatCrc()==0xCBF43926UL);
+  eeStatClr();
+  CHECK(eeStatCrc()==0 && eebytes==0 && eepages==0);
+}
+
+static void testVerify(){
+  uint8_t rec[8]={0};
+  uint16_t bad=0xFFFF;
+  reset(32);
+  eesize=4096;
+  //no CE on these, so erase falls back to filling with 0xFF
+  memset(part[1].mem,0x00,4096);
+  CHECK(eeErase()==0);
+  CHECK(eeVerify(0x0000,4096,0xFF,&bad)==0);
+  CHECK(eeFill(0x0100,0x0200,0x5A)==0);
+  CHECK(eeVerify(0x0100,0x0200,0x5A,&bad)==0);
+  //lowest mismatch over the whole gang
+  part[3].mem[0x0123]=0;
+  part[0].mem[0x0200]=0;
+  CHECK(eeVerify(0x0100,0x0200,0x5A,&bad)==0x09 && bad==0x0123);
+  //off the end of the part, rather than wrapping around
+  CHECK(eeVerify(0x0F00,0x0200,0xFF,&bad)==EEGANG && bad==0x0F00);
+  //a part that fails before anything is compared
+  reset(32);
+  part[1].stuck=1;
+  CHECK(eeCommit(0x0000,rec,8)==0);
+  bad=0xFFFF;
+  CHECK(eeVerify(0x0040,0x40,0xFF,&bad)==0x02 && bad==0x0040);
+}
+
+static void testErase(){
+  uint8_t rec[8]={0};
+  //chip erase goes to the whole gang, so it takes one tCE, not three
+  reset(32);
+  mocktce=2000000UL;
+  memset(part[3].mem,0x00,4096);
+  CHECK(eeErase()==0);
+  CHECK(simus>=mocktce && simus<=mocktce+1000);
+  CHECK(part[3].mem[0x0123]==0xFF);
+  //a part that's still erasing when we give up is left busy, so the
+  //next write doesn't go to it
+  reset(32);
+  mocktce=2000000UL;
+  part[1].stuck=1;
+  CHECK(eeErase()==0x02);
+  CHECK(simus>=EEERASE*1000000UL);
+  CHECK(eeCommit(0x0000,rec,8)==0);
+  CHECK(eeFlush()==0x02);
+  CHECK(part[1].writes==0 && part[0].writes==1);
+}
+
+/**
+ * @brief Fill the parts with something that isn't the probe's pattern
+*/
+static void scribble(){
+  for (int dev=0; dev<8; dev++) {
+    for (uint32_t a=0; a<65536; a++) {
+      part[dev].mem[a]=(uint8_t)(a*7+dev*13+(a>>8));
+    }
+  }
+}
+
+static void testProbe(){
+  static uint8_t before[8][PGMAX];
+  struct eePart pt;
+  //8k parts with 32 byte pages, already programmed
+  reset(PGSZ);
+  scribble();
+  for (int dev=0; dev<8; dev++) {
+    part[dev].size=8192;
+    part[dev].pgsz=32;
+    memcpy(before[dev],part[dev].mem,PGMAX);
+  }
+  uint8_t idx=eeProbe();
+  CHECK(idx<EENOPART);
+  eePartInfo(idx,&pt);
+  CHECK(pt.kb==8 && !pt.flash);
+  CHECK(eesize==8192 && eedrv.pgsz==32);
+  CHECK(eetmo==pt.twr*(2000/EEPOLL));
+  //and nothing was lost
+  for (int dev=0; dev<8; dev++) {
+    CHECK(!memcmp(before[dev],part[dev].mem,PGMAX));
+  }
+  CHECK(part[2].writes==0);
+  //mixed gang, runs at the smallest part
+  reset(PGSZ);
+  scribble();
+  part[3].size=4096;
+  part[1].pgsz=64;
+  part[0].pgsz=part[3].pgsz=128;
+  memcpy(before[1],part[1].mem,PGMAX);
+  idx=eeProbe();
+  eePartInfo(idx,&pt);
+  CHECK(pt.kb==4 && eesize==4096 && eedrv.pgsz==32);
+  CHECK(!memcmp(before[1],part[1].mem,PGMAX));
+  //a part that isn't there
+  reset(PGSZ);
+  part[1].nak=1;
+  CHECK(eeProbe()==EENOPART);
+  //same on SPI, where nothing NAKs: the pulled up MISO keeps WIP set
+  reset(PGSZ);
+  part[3].absent=1;
+  CHECK(eeProbe()==EENOPART);
+  //flash is never written, the ID and the table do it all
+  reset(PGSZ);
+  eedrv.ident=mockIdent;
+  part[0].id=part[1].id=part[3].id=17; //128k
+  idx=eeProbe();
+  CHECK(idx<EENOPART);
+  eePartInfo(idx,&pt);
+  CHECK(pt.kb==128 && pt.flash);
+  CHECK(eesize==65536 && eedrv.pgsz==PGMAX);
+  CHECK(part[0].writes==0 && part[1].writes==0 && part[3].writes==0);
+  eedrv.ident=0;
+}
+
+int main(){
+  testSplit();
+  testCoalesce();
+  testInterleave();
+  testFailMask();
+  testRange();
+  testCrc();
+  testVerify();
+  testErase();
+  testProbe();
+  printf("eetest: %s\n",fails ? "FAILED" : "OK");
+  return fails ? 1 : 0;
+}
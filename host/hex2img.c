@@ -0,0 +1,176 @@
+/***********************************************************************
+*                              File: hex2img.c
+*                     Copyright (c): 2019, Dan Purgert
+*                                  : dan@djph.net
+*
+*                           License: GNU GPL v2 only
+*                       Description: Host side tool.  Turns a (big) hex
+*                                  : file into a memory image, using
+*                                  : every core.
+*
+*                     Prerequisites:
+*                                  : cc (any C99 compiler), pthreads
+*                                  : make
+************************************************************************/
+
+/**
+ * @file
+ * @brief Hex file to memory image
+ *
+ * Usage: hex2img [-j threads] [-p pagesize] [-f fill] [-l] [-o out.bin]
+ *                file.hex
+ *
+ * Loads file.hex into a sparse image (see himg.h) and prints a summary:
+ * spans, bytes, address range and how many pages of pagesize (default
+ * 64) hold data.  -l lists those pages, in address order, which is the
+ * order the uploader wants them in.  -o writes a flat binary from the
+ * lowest address to the highest, holes filled with fill (default 0xFF).
+ *
+ * Exits 1 if the file is bad or any records overlap.
+*/
+
+#define _POSIX_C_SOURCE 199309L
+#include "himg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * @brief Page walk state
+*/
+struct pageList {
+  uint64_t pages; //!<Pages holding data
+  int list;       //!<Print each one
+};
+
+static int page(void *ctx, uint32_t addr, const uint8_t *data,
+                uint32_t used){
+  struct pageList *pl=ctx;
+  ++pl->pages;
+  if (pl->list) {
+    printf("%08lX %lu\n",(unsigned long)addr,(unsigned long)used);
+  }
+  return 0;
+}
+
+static double now(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec+ts.tv_nsec*1e-9;
+}
+
+/**
+ * @brief Write the image out flat, lowest to highest address
+*/
+static int writeBin(const struct himg *img, const char *fn, uint8_t fill){
+  static uint8_t blk[65536];
+  FILE *f=fopen(fn,"wb");
+  if (!f) {
+    perror(fn);
+    return 1;
+  }
+  if (img->n>0) {
+    const struct himgSpan *top=&img->span[img->n-1];
+    uint64_t addr=img->span[0].addr,
+             end=(uint64_t)top->addr+top->len;
+    while (addr<end) {
+      uint32_t n=(end-addr)>sizeof(blk) ? sizeof(blk)
+                                        : (uint32_t)(end-addr);
+      himgRead(img,(uint32_t)addr,n,blk,fill);
+      if (fwrite(blk,1,n,f)!=n) {
+        perror(fn);
+        fclose(f);
+        return 1;
+      }
+      addr+=n;
+    }
+  }
+  if (fclose(f)) {
+    perror(fn);
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv){
+  const char *fn=NULL, *out=NULL;
+  int threads=(int)sysconf(_SC_NPROCESSORS_ONLN), ret=0;
+  uint32_t pgsz=64;
+  uint8_t fill=0xFF;
+  struct pageList pl={0,0};
+  struct himg img;
+  size_t len=0, errpos=0;
+  char *buf;
+  for (int i=1; i<argc; i++) {
+    if (!strcmp(argv[i],"-j") && i+1<argc) {
+      threads=atoi(argv[++i]);
+    }
+    else if (!strcmp(argv[i],"-p") && i+1<argc) {
+      pgsz=strtoul(argv[++i],NULL,0);
+    }
+    else if (!strcmp(argv[i],"-f") && i+1<argc) {
+      fill=(uint8_t)strtoul(argv[++i],NULL,0);
+    }
+    else if (!strcmp(argv[i],"-o") && i+1<argc) {
+      out=argv[++i];
+    }
+    else if (!strcmp(argv[i],"-l")) {
+      pl.list=1;
+    }
+    else {
+      fn=argv[i];
+    }
+  }
+  if (!fn || pgsz==0) {
+    fprintf(stderr,"usage: %s [-j threads] [-p pagesize] [-f fill] [-l] "
+            "[-o out.bin] file.hex\n",argv[0]);
+    return 2;
+  }
+  if (threads<1) {
+    threads=1;
+  }
+  buf=ihexLoad(fn,&len);
+  if (!buf) {
+    perror(fn);
+    return 2;
+  }
+  double t0=now();
+  int err=himgLoad(&img,buf,len,threads,&errpos);
+  double t1=now();
+  free(buf);
+  if (err==HIMG_EOVERLAP) {
+    fprintf(stderr,"%s: %lu bytes overlap, first at %08lX\n",fn,
+            (unsigned long)img.overlaps,(unsigned long)img.overlap);
+    ret=1;
+  }
+  else if (err!=IHEX_OK) {
+    fprintf(stderr,"%s: %s",fn,himgStrerror(err));
+    if (err<HIMG_EOVERLAP) {
+      fprintf(stderr," at offset %zu",errpos);
+    }
+    fprintf(stderr,"\n");
+    himgFree(&img);
+    return 1;
+  }
+  if (!img.eof) {
+    fprintf(stderr,"%s: warning, no EOF record\n",fn);
+  }
+  himgPages(&img,pgsz,fill,page,&pl);
+  fprintf(stderr,"%zu bytes of hex in %.3fs on %d threads (%.1f MB/s)\n",
+          len,t1-t0,threads,len/(t1-t0)/1e6);
+  fprintf(stderr,"spans: %zu  bytes: %llu  pages: %llu\n",img.n,
+          (unsigned long long)img.bytes,(unsigned long long)pl.pages);
+  if (img.n>0) {
+    const struct himgSpan *top=&img.span[img.n-1];
+    fprintf(stderr,"range: %08lX - %08lX\n",
+            (unsigned long)img.span[0].addr,
+            (unsigned long)(top->addr+top->len-1));
+  }
+  if (out && writeBin(&img,out,fill)) {
+    ret=1;
+  }
+  himgFree(&img);
+  return ret;
+}
@@ -0,0 +1,196 @@
+/***********************************************************************
+*                              File: hexcrc.c
+*                     Copyright (c): 2019, Dan Purgert
+*                                  : dan@djph.net
+*
+*                           License: GNU GPL v2 only
+*                       Description: Host side tool.  Works out the
+*                                  : CRC32 / byte / page summary the
+*                                  : programmer reports at EOF, for a
+*                                  : given .hex file.
+*
+*                     Prerequisites:
+*                                  : cc (any C99 compiler)
+*                                  : make
+************************************************************************/
+
+/**
+ * @file
+ * @brief Expected EOF summary for a hex file
+ *
+ * Usage: hexcrc [-p pagesize] [-s size] file.hex
+ *
+ * Prints the same three lines the programmer sends after the EOF
+ * record, so the two can be compared directly.  The CRC covers the data
+ * bytes of every data record, in file order, same as the device.  The
+ * page count depends on the part's page size (default 64), as records
+ * are coalesced into pages the same way eeCommit() does it.
+ *
+ * File order is only address order if every record starts above the
+ * last one, and only then can the CRC be checked against the data
+ * pulled out of a flat binary or read back from the part (in address
+ * order, skipping the holes).  So a record that goes backwards gets a
+ * warning, and one that overlaps data already seen is an error, as the
+ * part then holds something other than what was summed.
+ *
+ * Anything else the programmer would reject is an error too: record
+ * types other than 00 and 01, records longer than RECSZ, and data past
+ * the end of a part of size bytes (default 65536).
+*/
+
+#include "ihex.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Longest data record the programmer takes (RECSZ, main.h)
+*/
+#define RECSZ 32
+
+uint32_t crc=0xFFFFFFFFUL, //!<Running CRC32 (not yet inverted)
+         bytes, //!<Data bytes seen
+         pages; //!<Page writes the programmer will do
+uint32_t pgsz=64, //!<Page size of the target part
+         pgadr, //!<Address of the first byte in the page buffer
+         pglen; //!<Bytes in the page buffer
+uint32_t size=65536, //!<Capacity of the target part
+         next; //!<Address just past the last data record
+int eof, //!<Seen the EOF record
+    back; //!<Warned about a record going backwards
+uint8_t seen[65536/8]; //!<Bit per address, set once it holds data
+
+/**
+ * @brief Add a byte to the CRC32 (same as crc32() in eeprom.c)
+*/
+static void crcByte(uint8_t data){
+  crc ^= data;
+  for (int i=0; i<8; i++) {
+    crc = (crc & 1) ? (crc>>1)^0xEDB88320UL : crc>>1;
+  }
+}
+
+/**
+ * @brief Follow the programmer's page buffer, counting page writes
+*/
+static void commit(uint32_t addr, uint32_t len){
+  while (len>0) {
+    if (pglen>0 && addr!=((pgadr+pglen)&0xFFFF)) {
+      ++pages;
+      pglen=0;
+    }
+    if (pglen==0) {
+      pgadr=addr;
+    }
+    uint32_t n=pgsz-(addr%pgsz);
+    if (n>len) {
+      n=len;
+    }
+    pglen+=n;
+    addr=(addr+n)&0xFFFF;
+    len-=n;
+    if ((addr%pgsz)==0) {
+      ++pages;
+      pglen=0;
+    }
+  }
+}
+
+/**
+ * @brief Per-record callback for ihexParse()
+*/
+static int record(void *ctx, const struct ihexRec *rec){
+  const char *fn=ctx;
+  switch (rec->type) {
+    case IHEX_DATA: {
+      if (rec->len>RECSZ) {
+        fprintf(stderr,"%s: %u byte record at offset %zu, the programmer "
+                "takes at most %d\n",fn,rec->len,rec->pos,RECSZ);
+        return 1;
+      }
+      if ((uint32_t)rec->addr+rec->len>size) {
+        fprintf(stderr,"%s: record at offset %zu runs past the end of a "
+                "%lu byte part\n",fn,rec->pos,(unsigned long)size);
+        return 1;
+      }
+      for (int i=0; i<rec->len; i++) {
+        uint16_t a=rec->addr+i;
+        if (seen[a>>3] & (1<<(a&7))) {
+          fprintf(stderr,"%s: record at offset %zu overlaps earlier data "
+                  "at %04X\n",fn,rec->pos,a);
+          return 1;
+        }
+        seen[a>>3] |= (1<<(a&7));
+      }
+      if (rec->addr<next && !back) {
+        fprintf(stderr,"%s: warning, record at offset %zu goes back to "
+                "%04X, the CRC follows file order, not address order\n",
+                fn,rec->pos,rec->addr);
+        back=1;
+      }
+      next=(uint32_t)rec->addr+rec->len;
+      for (int i=0; i<rec->len; i++) {
+        crcByte(rec->data[i]);
+      }
+      bytes+=rec->len;
+      commit(rec->addr,rec->len);
+      return 0;
+    }
+    case IHEX_EOF: {
+      eof=1;
+      return 1;
+    }
+    default: {
+      fprintf(stderr,"%s: record type %02X at offset %zu not supported "
+              "by the programmer\n",fn,rec->type,rec->pos);
+      return 1;
+    }
+  }
+}
+
+int main(int argc, char **argv){
+  const char *fn=NULL;
+  char *buf;
+  size_t len=0, errpos=0;
+  for (int i=1; i<argc; i++) {
+    if (!strcmp(argv[i],"-p") && i+1<argc) {
+      pgsz=strtoul(argv[++i],NULL,0);
+    }
+    else if (!strcmp(argv[i],"-s") && i+1<argc) {
+      size=strtoul(argv[++i],NULL,0);
+    }
+    else {
+      fn=argv[i];
+    }
+  }
+  if (!fn || pgsz==0 || size==0 || size>65536) {
+    fprintf(stderr,"usage: %s [-p pagesize] [-s size] file.hex\n",
+            argv[0]);
+    return 2;
+  }
+  buf=ihexLoad(fn,&len);
+  if (!buf) {
+    perror(fn);
+    return 2;
+  }
+  int err=ihexParse(buf,len,record,(void *)fn,&errpos);
+  free(buf);
+  if (err==IHEX_ESTOP && !eof) {
+    return 1;
+  }
+  if (err!=IHEX_OK && err!=IHEX_ESTOP) {
+    fprintf(stderr,"%s: %s at offset %zu\n",fn,ihexStrerror(err),errpos);
+    return 1;
+  }
+  if (!eof) {
+    fprintf(stderr,"%s: no EOF record\n",fn);
+    return 1;
+  }
+  if (pglen>0) {
+    ++pages;
+  }
+  printf("CRC32: %08lX\n",(unsigned long)~crc);
+  printf("bytes: %08lX\n",(unsigned long)bytes);
+  printf("pages: %08lX\n",(unsigned long)pages);
+  return 0;
+}
@@ -0,0 +1,426 @@
+/***********************************************************************
+*                              File: himg.c
+*                     Copyright (c): 2019, Dan Purgert
+*                                  : dan@djph.net
+*
+*                           License: GNU GPL v2 only
+*                       Description: Host side sparse memory image,
+*                                  : built from a hex file in parallel.
+*
+*                     Prerequisites:
+*                                  : cc (any C99 compiler), pthreads
+*                                  : make
+************************************************************************/
+
+/**
+ * @file
+*/
+
+#include "himg.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Contiguous records from one chunk
+*/
+struct himgRun {
+  uint32_t addr; //!<Address, or offset from the chunk's starting base
+  uint32_t len;  //!<Bytes
+  size_t off;    //!<Where the bytes are in the chunk's data buffer
+  size_t pos;    //!<File offset of the first record
+  size_t span;   //!<Span it ends up in
+  int rel;       //!<addr is relative, no 02/04 seen yet in this chunk
+};
+
+/**
+ * @brief One thread's share of the file, and what it found there
+*/
+struct himgChunk {
+  const char *buf;     //!<Whole file
+  size_t off,          //!<Start of this chunk in buf
+         len;          //!<Length of this chunk
+  int err;             //!<ihexParse() result
+  size_t errpos;       //!<File offset of the error
+  int known;           //!<Seen an 02 / 04 record
+  uint32_t base;       //!<Base address from the last 02 / 04 record
+  int brk;             //!<Base changed, next record starts a new run
+  size_t eof;          //!<File offset of an EOF record, or SIZE_MAX
+  struct himgRun *run; //!<Runs, in file order
+  size_t nrun,
+         caprun;
+  uint8_t *data;       //!<Data bytes for all the runs
+  size_t ndata,
+         capdata;
+  struct himg *img;    //!<Image being filled (copy stage)
+};
+
+/**
+ * @brief Grow *p (of *cap elements of sz bytes) to hold at least need
+*/
+static int himgGrow(void **p, size_t *cap, size_t need, size_t sz){
+  if (need<=*cap) {
+    return 0;
+  }
+  size_t ncap=*cap ? *cap*2 : 1024;
+  while (ncap<need) {
+    ncap*=2;
+  }
+  void *np=realloc(*p,ncap*sz);
+  if (!np) {
+    return 1;
+  }
+  *p=np;
+  *cap=ncap;
+  return 0;
+}
+
+/**
+ * @brief Add some data to the chunk, extending the last run if it can
+*/
+static int himgAdd(struct himgChunk *c, uint16_t addr,
+                   const uint8_t *data, uint32_t len, size_t pos){
+  struct himgRun *r=c->nrun ? &c->run[c->nrun-1] : NULL;
+  int rel=!c->known;
+  uint32_t a=rel ? addr : c->base+addr;
+  if (len==0) {
+    //an empty record holds nothing, it mustn't turn into an empty span
+    return 0;
+  }
+  if (!r || c->brk || r->rel!=rel || (uint64_t)r->addr+r->len!=a) {
+    if (himgGrow((void **)&c->run,&c->caprun,c->nrun+1,sizeof(*r))) {
+      return 1;
+    }
+    r=&c->run[c->nrun++];
+    r->addr=a;
+    r->len=0;
+    r->off=c->ndata;
+    r->pos=pos;
+    r->rel=rel;
+    c->brk=0;
+  }
+  if (himgGrow((void **)&c->data,&c->capdata,c->ndata+len,1)) {
+    return 1;
+  }
+  memcpy(c->data+c->ndata,data,len);
+  c->ndata+=len;
+  r->len+=len;
+  return 0;
+}
+
+/**
+ * @brief ihexParse() callback
+*/
+static int himgRec(void *ctx, const struct ihexRec *rec){
+  struct himgChunk *c=ctx;
+  size_t pos=c->off+rec->pos;
+  switch (rec->type) {
+    case IHEX_DATA: {
+      //the offset wraps around inside its 64k, it doesn't carry
+      uint32_t n=rec->len,
+               first=0x10000-rec->addr;
+      if (n>first) {
+        if (himgAdd(c,rec->addr,rec->data,first,pos)
+            || himgAdd(c,0,rec->data+first,n-first,pos)) {
+          c->err=HIMG_ENOMEM;
+          return 1;
+        }
+      }
+      else if (himgAdd(c,rec->addr,rec->data,n,pos)) {
+        c->err=HIMG_ENOMEM;
+        return 1;
+      }
+      break;
+    }
+    case IHEX_ESA: {
+      c->base=(uint32_t)((rec->data[0]<<8)|rec->data[1])<<4;
+      c->known=1;
+      c->brk=1;
+      break;
+    }
+    case IHEX_ELA: {
+      c->base=(uint32_t)((rec->data[0]<<8)|rec->data[1])<<16;
+      c->known=1;
+      c->brk=1;
+      break;
+    }
+    case IHEX_EOF: {
+      //nothing after this counts
+      c->eof=pos;
+      return 1;
+    }
+    default: {
+      //start addresses (03 / 05) don't go in the image
+      break;
+    }
+  }
+  return 0;
+}
+
+static void *himgParseChunk(void *arg){
+  struct himgChunk *c=arg;
+  c->err=ihexParse(c->buf+c->off,c->len,himgRec,c,&c->errpos);
+  c->errpos+=c->off;
+  if (c->err==IHEX_ESTOP && c->eof!=SIZE_MAX) {
+    c->err=IHEX_OK;
+  }
+  return NULL;
+}
+
+/**
+ * @brief Copy a chunk's runs into their spans
+*/
+static void *himgCopyChunk(void *arg){
+  struct himgChunk *c=arg;
+  for (size_t i=0; i<c->nrun; i++) {
+    struct himgRun *r=&c->run[i];
+    struct himgSpan *s=&c->img->span[r->span];
+    memcpy(s->data+(r->addr-s->addr),c->data+r->off,r->len);
+  }
+  return NULL;
+}
+
+/**
+ * @brief Run fn over chunks [0,n) on their own threads
+ * Returns non-zero if a thread couldn't be started (the rest still
+ * finish before this returns).
+*/
+static int himgSpawn(void *(*fn)(void *), struct himgChunk *c, int n){
+  pthread_t *tid=malloc(n*sizeof(*tid));
+  int bad=0, started=0;
+  if (!tid) {
+    return 1;
+  }
+  for (; started<n; started++) {
+    if (pthread_create(&tid[started],NULL,fn,&c[started])) {
+      bad=1;
+      break;
+    }
+  }
+  for (int i=0; i<started; i++) {
+    pthread_join(tid[i],NULL);
+  }
+  free(tid);
+  return bad;
+}
+
+static int himgCmp(const void *a, const void *b){
+  const struct himgRun *x=*(struct himgRun * const *)a,
+                       *y=*(struct himgRun * const *)b;
+  if (x->addr!=y->addr) {
+    return x->addr<y->addr ? -1 : 1;
+  }
+  return x->pos<y->pos ? -1 : (x->pos>y->pos);
+}
+
+int himgLoad(struct himg *img, const char *buf, size_t len, int threads,
+             size_t *errpos){
+  struct himgChunk *c;
+  struct himgRun **sorted=NULL;
+  size_t nrun=0, at=0;
+  int err=IHEX_OK, last;
+  uint32_t base=0;
+  memset(img,0,sizeof(*img));
+  if (threads<1) {
+    threads=1;
+  }
+  c=calloc(threads,sizeof(*c));
+  if (!c) {
+    return HIMG_ENOMEM;
+  }
+  //split at record boundaries; a ':' never turns up inside a record
+  for (int i=0; i<threads; i++) {
+    size_t end=len/threads*(i+1);
+    if (i==threads-1) {
+      end=len;
+    }
+    while (end<len && buf[end]!=':') {
+      ++end;
+    }
+    if (end<at) {
+      end=at;
+    }
+    c[i].buf=buf;
+    c[i].off=at;
+    c[i].len=end-at;
+    c[i].eof=SIZE_MAX;
+    c[i].img=img;
+    at=end;
+  }
+  if (himgSpawn(himgParseChunk,c,threads)) {
+    err=HIMG_ENOMEM;
+    goto done;
+  }
+  //stitch the chunks together in file order, up to the EOF record
+  for (last=0; last<threads; last++) {
+    if (c[last].err!=IHEX_OK) {
+      err=c[last].err;
+      if (errpos) {
+        *errpos=c[last].errpos;
+      }
+      goto done;
+    }
+    for (size_t j=0; j<c[last].nrun; j++) {
+      if (c[last].run[j].rel) {
+        c[last].run[j].addr+=base;
+        c[last].run[j].rel=0;
+      }
+    }
+    if (c[last].known) {
+      base=c[last].base;
+    }
+    nrun+=c[last].nrun;
+    if (c[last].eof!=SIZE_MAX) {
+      img->eof=1;
+      break;
+    }
+  }
+  if (last==threads) {
+    --last;
+  }
+  //sort by address, then work out the spans
+  sorted=malloc((nrun ? nrun : 1)*sizeof(*sorted));
+  img->span=malloc((nrun ? nrun : 1)*sizeof(*img->span));
+  if (!sorted || !img->span) {
+    err=HIMG_ENOMEM;
+    goto done;
+  }
+  nrun=0;
+  for (int i=0; i<=last; i++) {
+    for (size_t j=0; j<c[i].nrun; j++) {
+      sorted[nrun++]=&c[i].run[j];
+    }
+  }
+  qsort(sorted,nrun,sizeof(*sorted),himgCmp);
+  uint64_t end=0;
+  for (size_t i=0; i<nrun; i++) {
+    struct himgRun *r=sorted[i];
+    uint64_t rend=(uint64_t)r->addr+r->len;
+    if (img->n>0 && r->addr<=end) {
+      if (r->addr<end) {
+        if (!img->overlaps) {
+          img->overlap=r->addr;
+        }
+        img->overlaps+=(rend<end ? rend : end)-r->addr;
+      }
+      if (rend>end) {
+        end=rend;
+      }
+    }
+    else {
+      img->span[img->n].addr=r->addr;
+      img->span[img->n].data=NULL;
+      ++img->n;
+      end=rend;
+    }
+    img->span[img->n-1].len=(uint32_t)(end-img->span[img->n-1].addr);
+    r->span=img->n-1;
+  }
+  for (size_t i=0; i<img->n; i++) {
+    img->span[i].data=malloc(img->span[i].len ? img->span[i].len : 1);
+    if (!img->span[i].data) {
+      err=HIMG_ENOMEM;
+      goto done;
+    }
+    img->bytes+=img->span[i].len;
+  }
+  //fill them.  With overlaps the later record has to win, so that has
+  //to be done in file order, otherwise every chunk goes at once.
+  if (img->overlaps) {
+    for (int i=0; i<=last; i++) {
+      himgCopyChunk(&c[i]);
+    }
+    err=HIMG_EOVERLAP;
+  }
+  else if (himgSpawn(himgCopyChunk,c,last+1)) {
+    err=HIMG_ENOMEM;
+  }
+done:
+  for (int i=0; i<threads; i++) {
+    free(c[i].run);
+    free(c[i].data);
+  }
+  free(c);
+  free(sorted);
+  return err;
+}
+
+void himgFree(struct himg *img){
+  for (size_t i=0; i<img->n; i++) {
+    free(img->span[i].data);
+  }
+  free(img->span);
+  memset(img,0,sizeof(*img));
+}
+
+const char *himgStrerror(int err){
+  switch (err) {
+    case HIMG_EOVERLAP: return "overlapping records";
+    case HIMG_ENOMEM: return "out of memory";
+    default: return ihexStrerror(err);
+  }
+}
+
+const struct himgSpan *himgFind(const struct himg *img, uint32_t addr){
+  size_t lo=0, hi=img->n;
+  //first span that ends above addr
+  while (lo<hi) {
+    size_t mid=lo+(hi-lo)/2;
+    const struct himgSpan *s=&img->span[mid];
+    if ((uint64_t)s->addr+s->len<=addr) {
+      lo=mid+1;
+    }
+    else {
+      hi=mid;
+    }
+  }
+  return lo<img->n ? &img->span[lo] : NULL;
+}
+
+uint32_t himgRead(const struct himg *img, uint32_t addr, uint32_t len,
+                  uint8_t *buf, uint8_t fill){
+  const struct himgSpan *s=himgFind(img,addr),
+                        *stop=img->span+img->n;
+  uint64_t end=(uint64_t)addr+len;
+  uint32_t used=0;
+  memset(buf,fill,len);
+  for (; s && s<stop && s->addr<end; s++) {
+    uint64_t from=s->addr>addr ? s->addr : addr,
+             to=(uint64_t)s->addr+s->len;
+    if (to>end) {
+      to=end;
+    }
+    memcpy(buf+(from-addr),s->data+(from-s->addr),(size_t)(to-from));
+    used+=(uint32_t)(to-from);
+  }
+  return used;
+}
+
+int himgPages(const struct himg *img, uint32_t pgsz, uint8_t fill,
+              himgPageCb cb, void *ctx){
+  uint8_t *buf=malloc(pgsz ? pgsz : 1);
+  uint64_t p=0;
+  int ret=0;
+  if (!buf || pgsz==0) {
+    free(buf);
+    return -1;
+  }
+  while (!ret && p<=0xFFFFFFFFULL) {
+    const struct himgSpan *s=himgFind(img,(uint32_t)p);
+    if (!s) {
+      break;
+    }
+    if (s->addr>=p+pgsz) {
+      //nothing in this page, skip ahead to the next one with data
+      p=(uint64_t)s->addr/pgsz*pgsz;
+    }
+    uint32_t used=himgRead(img,(uint32_t)p,
+                           (uint32_t)(p+pgsz>0x100000000ULL
+                                      ? 0x100000000ULL-p : pgsz),
+                           buf,fill);
+    ret=cb(ctx,(uint32_t)p,buf,used);
+    p+=pgsz;
+  }
+  free(buf);
+  return ret;
+}
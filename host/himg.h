@@ -0,0 +1,115 @@
+/***********************************************************************
+*                              File: himg.h
+*                     Copyright (c): 2019, Dan Purgert
+*                                  : dan@djph.net
+*
+*                           License: GNU GPL v2 only
+*                       Description: Host side sparse memory image,
+*                                  : built from a hex file in parallel.
+*
+*                     Prerequisites:
+*                                  : cc (any C99 compiler), pthreads
+*                                  : make
+************************************************************************/
+
+/**
+ * @file
+ * @brief Sparse memory image
+ *
+ * Turns a hex file into a sorted list of non-overlapping spans of
+ * data, resolving the extended address records (02 / 04) that the
+ * firmware doesn't handle yet.
+ *
+ * The file is split into one chunk per thread, at record boundaries
+ * (a ':' only ever starts a record).  Each thread parses its chunk with
+ * ihexParse(), gathering contiguous records into runs.  Until a chunk
+ * sees its first 02 / 04 record it can't know its base address, so
+ * those runs are kept relative, and get the base the previous chunks
+ * ended on when the chunks are merged, in file order.  The runs are then
+ * sorted by address and joined into spans.  Overlapping runs are
+ * counted, and where they overlap the one later in the file wins.
+ *
+ * Anything after the first EOF record is ignored.
+*/
+
+#ifndef __HEX_HOST_HIMG__
+  #define __HEX_HOST_HIMG__ 1
+  #include "ihex.h"
+
+  /**
+   * @brief himgLoad() result, past the ihexParse() ones
+  */
+  #define HIMG_EOVERLAP 0x100
+  /**
+   * @brief himgLoad() result, out of memory (or couldn't start a thread)
+  */
+  #define HIMG_ENOMEM 0x101
+
+  /**
+   * @brief A run of data with no holes in it
+  */
+  struct himgSpan {
+    uint32_t addr; //!<First address
+    uint32_t len;  //!<Bytes
+    uint8_t *data; //!<len bytes
+  };
+
+  /**
+   * @brief Sparse memory image
+  */
+  struct himg {
+    struct himgSpan *span; //!<Spans, sorted by address
+    size_t n;              //!<Number of spans
+    uint64_t bytes;        //!<Total bytes of data
+    int eof;               //!<Seen an EOF record
+    uint64_t overlaps;     //!<Bytes written more than once
+    uint32_t overlap;      //!<First address written more than once
+  };
+
+  /**
+   * @brief Build an image from len bytes of hex at buf
+   *
+   * threads is the number of chunks / threads to use (1 or more).
+   * Returns IHEX_OK, one of the ihexParse() errors (with *errpos set to
+   * its offset in buf), HIMG_EOVERLAP or HIMG_ENOMEM.  On
+   * HIMG_EOVERLAP the image is still complete (later records win) and
+   * overlaps / overlap say how much and where.  It must be freed
+   * whatever the result.
+  */
+  int himgLoad(struct himg *img, const char *buf, size_t len, int threads,
+               size_t *errpos);
+  /**
+   * @brief Free an image
+  */
+  void himgFree(struct himg *img);
+  /**
+   * @brief Describe a himgLoad() result
+  */
+  const char *himgStrerror(int err);
+  /**
+   * @brief Find the span holding addr, or failing that the next one up
+   * Returns NULL if there's no data at or above addr.
+  */
+  const struct himgSpan *himgFind(const struct himg *img, uint32_t addr);
+  /**
+   * @brief Copy len bytes from addr into buf
+   * Holes are filled with fill.  Returns the number of bytes that
+   * actually held data.
+  */
+  uint32_t himgRead(const struct himg *img, uint32_t addr, uint32_t len,
+                    uint8_t *buf, uint8_t fill);
+  /**
+   * @brief Page callback
+   * data is pgsz bytes (holes filled in), used is how many held data.
+   * Return non-zero to stop.
+  */
+  typedef int (*himgPageCb)(void *ctx, uint32_t addr, const uint8_t *data,
+                            uint32_t used);
+  /**
+   * @brief Visit every page (pgsz aligned) holding any data, in order
+   * Returns whatever stopped the walk, 0 if it ran to the end.
+  */
+  int himgPages(const struct himg *img, uint32_t pgsz, uint8_t fill,
+                himgPageCb cb, void *ctx);
+
+#endif
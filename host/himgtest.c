@@ -0,0 +1,233 @@
+/***********************************************************************
+*                              File: himgtest.c
+*                     Copyright (c): 2019, Dan Purgert
+*                                  : dan@djph.net
+*
+*                           License: GNU GPL v2 only
+*                       Description: Host side test of the sparse image
+*                                  : (himg.c), against a reference model.
+*
+*                     Prerequisites:
+*                                  : cc (any C99 compiler), pthreads
+*                                  : make
+************************************************************************/
+
+/**
+ * @file
+ * @brief Sparse image tests
+ *
+ * Usage: himgtest [files] (or "make check")
+ *
+ * Writes random hex files, and loads each one with himgLoad() on 1, 2,
+ * 3, 8 and 17 threads.  Chunk boundaries then fall all over the place,
+ * in particular between an 02 / 04 record and the data that depends on
+ * it, which is what the stitching in himgLoad() has to get right.
+ *
+ * The files mix data records (some wrapping past the top of their 64k),
+ * 02 and 04 records, CR / LF / blank line endings, overlapping records
+ * and a data record after the EOF record.  Every address is kept under
+ * 256k, so the model is just a flat array: each data byte is written
+ * in file order, and how many times each address was written is
+ * counted.  The image has to match it byte for byte, with maximal
+ * spans, the same overlap count and first overlap, the same pages and
+ * the same himgRead() results.
+ *
+ * Prints each failed check (with the file number) and exits 1 if there
+ * were any.
+*/
+
+#include "himg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MODELSZ 0x40000 //!<Model address space (256k)
+#define HEXMAX  65536   //!<Room for one hex file
+#define PGSZ    64      //!<Page size for the himgPages() check
+
+uint8_t mem[MODELSZ];  //!<Model: last byte written to each address
+uint8_t cnt[MODELSZ];  //!<Model: times each address was written
+char hex[HEXMAX];      //!<Hex file being tested
+size_t hexlen;
+uint32_t rng=1;        //!<xorshift state, so every run is the same
+int fails, file;
+
+#define CHECK(c) do { \
+    if (!(c)) { \
+      printf("%s:%d: file %d: %s\n",__FILE__,__LINE__,file,#c); \
+      ++fails; \
+    } \
+  } while (0)
+
+static uint32_t rnd(uint32_t n){
+  rng^=rng<<13;
+  rng^=rng>>17;
+  rng^=rng<<5;
+  return rng%n;
+}
+
+/**
+ * @brief Append one record (with a random line ending) to hex[]
+*/
+static void rec(uint8_t type, uint16_t addr, const uint8_t *data,
+                uint8_t len){
+  static const char *eol[]={"\n","\r\n","\n\n"};
+  uint8_t sum=len+(addr>>8)+(addr&0xFF)+type;
+  hexlen+=sprintf(hex+hexlen,":%02X%04X%02X",len,addr,type);
+  for (int i=0; i<len; i++) {
+    hexlen+=sprintf(hex+hexlen,"%02X",data[i]);
+    sum+=data[i];
+  }
+  hexlen+=sprintf(hex+hexlen,"%02X%s",(uint8_t)-sum,eol[rnd(3)]);
+}
+
+/**
+ * @brief Write a random file to hex[], and work out the model
+*/
+static void gen(){
+  uint8_t d[40];
+  uint32_t base=0;
+  memset(mem,0,sizeof(mem));
+  memset(cnt,0,sizeof(cnt));
+  hexlen=0;
+  for (int r=rnd(400)+1; r>0; r--) {
+    uint32_t pick=rnd(100);
+    if (pick<5) {
+      //04, upper 16 bits 0..3
+      uint16_t v=rnd(4);
+      d[0]=v>>8;
+      d[1]=v;
+      rec(IHEX_ELA,0,d,2);
+      base=(uint32_t)v<<16;
+    }
+    else if (pick<8) {
+      //02, segment up to 0x3000
+      uint16_t v=rnd(0x3001);
+      d[0]=v>>8;
+      d[1]=v;
+      rec(IHEX_ESA,0,d,2);
+      base=(uint32_t)v<<4;
+    }
+    else {
+      //data, now and then right at the top so it wraps
+      uint16_t a=rnd(4) ? rnd(0x10000) : 0xFFF0+rnd(16);
+      uint8_t n=rnd(41);
+      for (int i=0; i<n; i++) {
+        d[i]=rnd(256);
+        uint32_t at=base+(uint16_t)(a+i);
+        mem[at]=d[i];
+        ++cnt[at];
+      }
+      rec(IHEX_DATA,a,d,n);
+    }
+  }
+  rec(IHEX_EOF,0,NULL,0);
+  //ignored, it's after the EOF record
+  d[0]=1;
+  rec(IHEX_DATA,0,d,1);
+}
+
+struct pageCount {
+  uint32_t pages;
+  int bad;
+};
+
+static int page(void *ctx, uint32_t addr, const uint8_t *data,
+                uint32_t used){
+  struct pageCount *pc=ctx;
+  uint32_t n=0;
+  ++pc->pages;
+  for (uint32_t i=0; i<PGSZ; i++) {
+    uint32_t a=addr+i;
+    if (a<MODELSZ && cnt[a]) {
+      ++n;
+      pc->bad|=(data[i]!=mem[a]);
+    }
+    else {
+      pc->bad|=(data[i]!=0xA5);
+    }
+  }
+  pc->bad|=(n!=used || n==0);
+  return 0;
+}
+
+/**
+ * @brief Check an image against the model
+*/
+static void check(const struct himg *img, int err){
+  uint64_t bytes=0, over=0;
+  uint32_t first=0, pages=0;
+  uint8_t buf[1024];
+  for (uint32_t a=0; a<MODELSZ; a++) {
+    if (cnt[a]) {
+      ++bytes;
+      if (cnt[a]>1) {
+        if (!over) {
+          first=a;
+        }
+        over+=cnt[a]-1;
+      }
+    }
+  }
+  for (uint32_t p=0; p<MODELSZ; p+=PGSZ) {
+    for (uint32_t j=0; j<PGSZ; j++) {
+      if (cnt[p+j]) {
+        ++pages;
+        break;
+      }
+    }
+  }
+  CHECK(err==(over ? HIMG_EOVERLAP : IHEX_OK));
+  CHECK(img->eof);
+  CHECK(img->bytes==bytes);
+  CHECK(img->overlaps==over);
+  CHECK(!over || img->overlap==first);
+  for (size_t i=0; i<img->n; i++) {
+    const struct himgSpan *s=&img->span[i];
+    CHECK(s->len>0 && (uint64_t)s->addr+s->len<=MODELSZ);
+    //maximal: nothing right before it
+    CHECK(s->addr==0 || !cnt[s->addr-1]);
+    CHECK((uint64_t)s->addr+s->len==MODELSZ || !cnt[s->addr+s->len]);
+    for (uint32_t j=0; j<s->len; j++) {
+      if (!cnt[s->addr+j] || s->data[j]!=mem[s->addr+j]) {
+        CHECK(!"span data matches the model");
+        break;
+      }
+    }
+  }
+  struct pageCount pc={0,0};
+  himgPages(img,PGSZ,0xA5,page,&pc);
+  CHECK(pc.pages==pages && !pc.bad);
+  for (int i=0; i<8; i++) {
+    uint32_t a=rnd(MODELSZ), n=rnd(sizeof(buf))+1, used=0;
+    if (a+n>MODELSZ) {
+      n=MODELSZ-a;
+    }
+    uint32_t got=himgRead(img,a,n,buf,0x5A);
+    for (uint32_t j=0; j<n; j++) {
+      used+=(cnt[a+j]!=0);
+      if (buf[j]!=(cnt[a+j] ? mem[a+j] : 0x5A)) {
+        CHECK(!"himgRead() matches the model");
+        break;
+      }
+    }
+    CHECK(got==used);
+  }
+}
+
+int main(int argc, char **argv){
+  static const int threads[]={1, 2, 3, 8, 17};
+  int files=(argc>1) ? atoi(argv[1]) : 200;
+  for (file=0; file<files; file++) {
+    gen();
+    for (int t=0; t<(int)(sizeof(threads)/sizeof(threads[0])); t++) {
+      struct himg img;
+      size_t errpos=0;
+      int err=himgLoad(&img,hex,hexlen,threads[t],&errpos);
+      check(&img,err);
+      himgFree(&img);
+    }
+  }
+  printf("himgtest: %d files, %s\n",files,fails ? "FAILED" : "OK");
+  return fails ? 1 : 0;
+}
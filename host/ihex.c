@@ -0,0 +1,290 @@
+/***********************************************************************
+*                              File: ihex.c
+*                     Copyright (c): 2019, Dan Purgert
+*                                  : dan@djph.net
+*
+*                           License: GNU GPL v2 only
+*                       Description: Host side Intel HEX parser, for
+*                                  : checking images before they go out
+*                                  : to the programmer.
+*
+*                     Prerequisites:
+*                                  : cc (any C99 compiler, SIMD kernels
+*                                  : need gcc or clang on x86)
+*                                  : make
+************************************************************************/
+
+/**
+ * @file
+*/
+
+#include "ihex.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#if !defined(IHEX_SCALAR) && defined(__SSE2__)
+  #define IHEX_SSE2 1
+  #include <emmintrin.h>
+#endif
+#if !defined(IHEX_SCALAR) && defined(__AVX2__)
+  #define IHEX_AVX2 1
+  #include <immintrin.h>
+#endif
+
+/**
+ * @brief Value of one hex digit, or -1
+*/
+static int ihexNibble(uint8_t c){
+  if ((uint8_t)(c-'0')<10) {
+    return c-'0';
+  }
+  c|=0x20; //fold A-F onto a-f
+  if ((uint8_t)(c-'a')<6) {
+    return c-'a'+10;
+  }
+  return -1;
+}
+
+int ihexDecodeScalar(uint8_t *dst, const char *src, size_t n){
+  int bad=0;
+  for (size_t i=0; i<n; i++) {
+    int hi=ihexNibble(src[2*i]),
+        lo=ihexNibble(src[2*i+1]);
+    bad|=(hi|lo);
+    dst[i]=(uint8_t)((hi<<4)|lo);
+  }
+  return bad<0;
+}
+
+#ifdef IHEX_SSE2
+/*
+ * Both SIMD kernels work the same way:
+ *  - a character is a digit if it's in '0'..'9', or a letter if, with
+ *    bit 5 set (lower case), it's in 'a'..'f'.  Signed compares are
+ *    fine, anything >= 0x80 is negative and fails both tests.
+ *  - the nibble is the low 4 bits, plus 9 for letters.
+ *  - as 16-bit lanes, each pair of characters is hi nibble in the low
+ *    byte, lo nibble in the high byte.  Swap them into one byte, then
+ *    pack the lanes down to bytes.
+ * Bad characters are OR'd into a flag and checked once at the end.
+*/
+
+/**
+ * @brief Decode 16 characters into 8 bytes
+ * Returns all ones in the lanes that held a valid digit.
+*/
+static inline __m128i ihexBlock16(uint8_t *dst, const char *src){
+  __m128i v=_mm_loadu_si128((const __m128i *)src),
+          lc=_mm_or_si128(v,_mm_set1_epi8(0x20)),
+          dig=_mm_and_si128(_mm_cmpgt_epi8(v,_mm_set1_epi8('0'-1)),
+                            _mm_cmplt_epi8(v,_mm_set1_epi8('9'+1))),
+          alp=_mm_and_si128(_mm_cmpgt_epi8(lc,_mm_set1_epi8('a'-1)),
+                            _mm_cmplt_epi8(lc,_mm_set1_epi8('f'+1))),
+          nib=_mm_add_epi8(_mm_and_si128(v,_mm_set1_epi8(0x0F)),
+                           _mm_and_si128(alp,_mm_set1_epi8(9))),
+          w=_mm_or_si128(_mm_and_si128(_mm_slli_epi16(nib,4),
+                                       _mm_set1_epi16(0x00F0)),
+                         _mm_srli_epi16(nib,8));
+  _mm_storel_epi64((__m128i *)dst,_mm_packus_epi16(w,w));
+  return _mm_or_si128(dig,alp);
+}
+#endif
+
+#ifdef IHEX_AVX2
+/**
+ * @brief Decode 32 characters into 16 bytes
+*/
+static inline __m256i ihexBlock32(uint8_t *dst, const char *src){
+  __m256i v=_mm256_loadu_si256((const __m256i *)src),
+          lc=_mm256_or_si256(v,_mm256_set1_epi8(0x20)),
+          dig=_mm256_and_si256(
+                _mm256_cmpgt_epi8(v,_mm256_set1_epi8('0'-1)),
+                _mm256_cmpgt_epi8(_mm256_set1_epi8('9'+1),v)),
+          alp=_mm256_and_si256(
+                _mm256_cmpgt_epi8(lc,_mm256_set1_epi8('a'-1)),
+                _mm256_cmpgt_epi8(_mm256_set1_epi8('f'+1),lc)),
+          nib=_mm256_add_epi8(_mm256_and_si256(v,_mm256_set1_epi8(0x0F)),
+                              _mm256_and_si256(alp,_mm256_set1_epi8(9))),
+          w=_mm256_or_si256(_mm256_and_si256(_mm256_slli_epi16(nib,4),
+                                             _mm256_set1_epi16(0x00F0)),
+                            _mm256_srli_epi16(nib,8)),
+          p=_mm256_packus_epi16(w,w);
+  //packus works per 128-bit lane, quads 0 and 2 hold the result
+  p=_mm256_permute4x64_epi64(p,0x08);
+  _mm_storeu_si128((__m128i *)dst,_mm256_castsi256_si128(p));
+  return _mm256_or_si256(dig,alp);
+}
+#endif
+
+#ifdef IHEX_SSE2
+/**
+ * @brief Fastest decoder built in
+*/
+static int ihexDecodeSimd(uint8_t *dst, const char *src, size_t n){
+  const char *end=src+2*n;
+  uint8_t *dend=dst+n;
+  if (n<8) {
+    return ihexDecodeScalar(dst,src,n);
+  }
+  //the tail is done by re-decoding an overlapping block that ends on
+  //the last byte, which beats finishing off one byte at a time
+  #ifdef IHEX_AVX2
+    if (n>=16) {
+      __m256i ok=_mm256_set1_epi8(-1);
+      for (; n>16; n-=16, src+=32, dst+=16) {
+        ok=_mm256_and_si256(ok,ihexBlock32(dst,src));
+      }
+      ok=_mm256_and_si256(ok,ihexBlock32(dend-16,end-32));
+      return (_mm256_movemask_epi8(ok)!=-1);
+    }
+  #endif
+  __m128i ok=_mm_set1_epi8(-1);
+  for (; n>8; n-=8, src+=16, dst+=8) {
+    ok=_mm_and_si128(ok,ihexBlock16(dst,src));
+  }
+  ok=_mm_and_si128(ok,ihexBlock16(dend-8,end-16));
+  return (_mm_movemask_epi8(ok)!=0xFFFF);
+}
+
+ihexDecodeFn ihexDecode=ihexDecodeSimd;
+#else
+ihexDecodeFn ihexDecode=ihexDecodeScalar;
+#endif
+
+const char *ihexKernel(){
+  #if defined(IHEX_AVX2)
+    return "avx2";
+  #elif defined(IHEX_SSE2)
+    return "sse2";
+  #else
+    return "scalar";
+  #endif
+}
+
+/**
+ * @brief Find the first character in src[0..n) that isn't a hex digit
+*/
+static size_t ihexBadDigit(const char *src, size_t n){
+  size_t i=0;
+  while (i<n && ihexNibble(src[i])>=0) {
+    ++i;
+  }
+  return i;
+}
+
+/**
+ * @brief Byte count each record type has to have, -1 for "any"
+*/
+static const int ihexTypeLen[]={-1, 0, 2, 4, 2, 4};
+
+int ihexParse(const char *buf, size_t len, ihexCb cb, void *ctx,
+              size_t *errpos){
+  uint8_t rec[5+255];
+  struct ihexRec r;
+  size_t p=0, at=0;
+  int err=IHEX_OK;
+  while (p<len && err==IHEX_OK) {
+    char c=buf[p];
+    if (c=='\r' || c=='\n') {
+      //between records, same as INITST
+      ++p;
+      continue;
+    }
+    at=p;
+    if (c!=':') {
+      err=IHEX_ESYNC;
+      break;
+    }
+    if (len-p<11) {
+      at=len;
+      err=IHEX_ETRUNC;
+      break;
+    }
+    if (ihexDecodeScalar(rec,buf+p+1,1)) {
+      at=p+1+ihexBadDigit(buf+p+1,2);
+      err=IHEX_EDIGIT;
+      break;
+    }
+    //byte count, address (2), type, data, checksum
+    size_t n=(size_t)rec[0]+5,
+           chars=1+2*n;
+    if (len-p<chars) {
+      at=len;
+      err=IHEX_ETRUNC;
+      break;
+    }
+    if (ihexDecode(rec+1,buf+p+3,n-1)) {
+      at=p+3+ihexBadDigit(buf+p+3,2*(n-1));
+      err=IHEX_EDIGIT;
+      break;
+    }
+    uint8_t sum=0;
+    for (size_t i=0; i<n; i++) {
+      sum+=rec[i];
+    }
+    if (sum!=0) {
+      at=p+chars-2;
+      err=IHEX_ECKSUM;
+      break;
+    }
+    r.len=rec[0];
+    r.addr=(uint16_t)((rec[1]<<8)|rec[2]);
+    r.type=rec[3];
+    r.data=rec+4;
+    r.pos=p;
+    if (r.type>IHEX_SLA) {
+      at=p+7;
+      err=IHEX_ETYPE;
+      break;
+    }
+    if (ihexTypeLen[r.type]>=0 && r.len!=ihexTypeLen[r.type]) {
+      at=p+1;
+      err=IHEX_ELEN;
+      break;
+    }
+    if (cb && cb(ctx,&r)) {
+      err=IHEX_ESTOP;
+    }
+    p+=chars;
+  }
+  if (err!=IHEX_OK && errpos) {
+    *errpos=at;
+  }
+  return err;
+}
+
+const char *ihexStrerror(int err){
+  switch (err) {
+    case IHEX_OK: return "ok";
+    case IHEX_ESYNC: return "expected ':' at start of record";
+    case IHEX_EDIGIT: return "not a hex digit";
+    case IHEX_ETRUNC: return "truncated record";
+    case IHEX_ECKSUM: return "bad checksum";
+    case IHEX_ETYPE: return "unknown record type";
+    case IHEX_ELEN: return "bad byte count for record type";
+    case IHEX_ESTOP: return "stopped";
+    default: return "unknown error";
+  }
+}
+
+char *ihexLoad(const char *fn, size_t *len){
+  FILE *f=fopen(fn,"rb");
+  char *buf=NULL;
+  long sz;
+  if (!f) {
+    return NULL;
+  }
+  if (fseek(f,0,SEEK_END)==0 && (sz=ftell(f))>=0
+      && fseek(f,0,SEEK_SET)==0) {
+    buf=malloc(sz ? (size_t)sz : 1);
+    if (buf && fread(buf,1,(size_t)sz,f)!=(size_t)sz) {
+      free(buf);
+      buf=NULL;
+    }
+    else if (buf) {
+      *len=(size_t)sz;
+    }
+  }
+  fclose(f);
+  return buf;
+}
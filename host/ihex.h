@@ -0,0 +1,126 @@
+/***********************************************************************
+*                              File: ihex.h
+*                     Copyright (c): 2019, Dan Purgert
+*                                  : dan@djph.net
+*
+*                           License: GNU GPL v2 only
+*                       Description: Host side Intel HEX parser, for
+*                                  : checking images before they go out
+*                                  : to the programmer.
+*
+*                     Prerequisites:
+*                                  : cc (any C99 compiler, SIMD kernels
+*                                  : need gcc or clang on x86)
+*                                  : make
+************************************************************************/
+
+/**
+ * @file
+ * @brief Host Intel HEX parser
+ *
+ * Follows the same record rules as prohex() in main.c:
+ *  - records start with ':', any number of CR / LF may sit between
+ *    records (the INITST rules), anything else is an error
+ *  - each record is checksummed, the sum of all its bytes must be 0
+ * Unlike the firmware it also knows record types 02 - 05, and checks
+ * their lengths, but it doesn't act on them; that's up to the caller.
+ *
+ * Hex digits are decoded 32 (AVX2) or 16 (SSE2) characters at a time
+ * where the compiler allows it, with a scalar fallback.  Build with
+ * -DIHEX_SCALAR to force the scalar kernel.
+*/
+
+#ifndef __HEX_HOST_IHEX__
+  #define __HEX_HOST_IHEX__ 1
+  #include <stddef.h>
+  #include <stdint.h>
+
+  /**
+   * @brief Record types
+  */
+  enum ihex_types {
+    IHEX_DATA,   //!<00 Data
+    IHEX_EOF,    //!<01 End of file
+    IHEX_ESA,    //!<02 Extended segment address
+    IHEX_SSA,    //!<03 Start segment address
+    IHEX_ELA,    //!<04 Extended linear address
+    IHEX_SLA,    //!<05 Start linear address
+  };
+
+  /**
+   * @brief Parser results
+  */
+  enum ihex_errors {
+    IHEX_OK,     //!<All records parsed
+    IHEX_ESYNC,  //!<Something other than ':' / CR / LF between records
+    IHEX_EDIGIT, //!<Not a hex digit
+    IHEX_ETRUNC, //!<Input ends part way through a record
+    IHEX_ECKSUM, //!<Checksum mismatch
+    IHEX_ETYPE,  //!<Unknown record type
+    IHEX_ELEN,   //!<Wrong byte count for the record type
+    IHEX_ESTOP,  //!<Callback asked us to stop
+  };
+
+  /**
+   * @brief One decoded record
+   *
+   * data points into a buffer owned by the parser, and is only good
+   * until the callback returns.
+  */
+  struct ihexRec {
+    uint8_t len;         //!<Byte count
+    uint16_t addr;       //!<Address offset
+    uint8_t type;        //!<Record type
+    const uint8_t *data; //!<len data bytes
+    size_t pos;          //!<Offset of the ':' in the input
+  };
+
+  /**
+   * @brief Record callback
+   * Return 0 to carry on, anything else stops the parse (IHEX_ESTOP).
+  */
+  typedef int (*ihexCb)(void *ctx, const struct ihexRec *rec);
+
+  /**
+   * @brief Hex digit decoder
+   *
+   * Decodes 2*n characters from src into n bytes at dst.  Returns 0 if
+   * every character was a hex digit (either case), non-zero otherwise,
+   * in which case dst is garbage.
+  */
+  typedef int (*ihexDecodeFn)(uint8_t *dst, const char *src, size_t n);
+
+  /**
+   * @brief Decoder used by ihexParse()
+   * Defaults to the fastest kernel built in.
+  */
+  extern ihexDecodeFn ihexDecode;
+  /**
+   * @brief Plain C decoder, one character at a time
+  */
+  int ihexDecodeScalar(uint8_t *dst, const char *src, size_t n);
+  /**
+   * @brief Name of the fastest kernel built in ("avx2", "sse2", "scalar")
+  */
+  const char *ihexKernel();
+
+  /**
+   * @brief Parse a buffer of hex records
+   *
+   * Calls cb for every record, in order.  Parsing carries on past an
+   * EOF record, as the firmware does.  On error, *errpos (if not NULL)
+   * is set to the offset of the offending character.
+  */
+  int ihexParse(const char *buf, size_t len, ihexCb cb, void *ctx,
+                size_t *errpos);
+  /**
+   * @brief Describe an ihexParse() result
+  */
+  const char *ihexStrerror(int err);
+  /**
+   * @brief Read a whole file into memory
+   * Returns a malloc()ed buffer (free it), or NULL with errno set.
+  */
+  char *ihexLoad(const char *fn, size_t *len);
+
+#endif
@@ -0,0 +1,175 @@
+/***********************************************************************
+*                              File: ihexbench.c
+*                     Copyright (c): 2019, Dan Purgert
+*                                  : dan@djph.net
+*
+*                           License: GNU GPL v2 only
+*                       Description: Benchmark for the host side hex
+*                                  : parser, SIMD kernel against the
+*                                  : scalar reference.
+*
+*                     Prerequisites:
+*                                  : cc (any C99 compiler)
+*                                  : make
+************************************************************************/
+
+/**
+ * @file
+ * @brief Host parser benchmark
+ *
+ * Usage: ihexbench [-m megabytes] [-r recordsize] [file.hex]
+ *
+ * Parses file.hex, or a generated image of the given size (default
+ * 256MB of 32 byte records), with the scalar decoder and then with the
+ * fastest one built in, and prints the throughput of each.  Both runs
+ * have to agree on the record count and a sum of the data, or it's
+ * reported as a mismatch.
+*/
+
+#define _POSIX_C_SOURCE 199309L
+#include "ihex.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * @brief What the callback saw, to prove both kernels agree
+*/
+struct tally {
+  uint64_t recs;
+  uint64_t sum;
+};
+
+static int count(void *ctx, const struct ihexRec *rec){
+  struct tally *t=ctx;
+  ++t->recs;
+  for (int i=0; i<rec->len; i++) {
+    t->sum+=rec->data[i];
+  }
+  return 0;
+}
+
+static double now(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec+ts.tv_nsec*1e-9;
+}
+
+/**
+ * @brief Append one record to buf, returns the characters written
+*/
+static size_t putRec(char *buf, uint8_t type, uint16_t addr,
+                     const uint8_t *data, uint8_t len){
+  static const char hx[]="0123456789ABCDEF";
+  uint8_t sum=len+(addr>>8)+(addr&0xFF)+type;
+  char *p=buf;
+  *p++=':';
+  #define PUT(b) do { *p++=hx[(b)>>4]; *p++=hx[(b)&0x0F]; } while (0)
+  PUT(len);
+  PUT(addr>>8);
+  PUT(addr&0xFF);
+  PUT(type);
+  for (int i=0; i<len; i++) {
+    PUT(data[i]);
+    sum+=data[i];
+  }
+  sum=(uint8_t)-sum;
+  PUT(sum);
+  #undef PUT
+  *p++='\r';
+  *p++='\n';
+  return (size_t)(p-buf);
+}
+
+/**
+ * @brief Generate about mb megabytes of hex, with 04 records every 64k
+*/
+static char *generate(size_t mb, uint8_t recsz, size_t *len){
+  size_t cap=mb<<20, n=0;
+  char *buf=malloc(cap+600);
+  uint8_t data[255];
+  uint32_t addr=0;
+  uint32_t seed=1;
+  if (!buf) {
+    return NULL;
+  }
+  while (n<cap) {
+    if ((addr&0xFFFF)==0) {
+      uint8_t ela[2]={(uint8_t)(addr>>24),(uint8_t)(addr>>16)};
+      n+=putRec(buf+n,IHEX_ELA,0,ela,2);
+    }
+    for (int i=0; i<recsz; i++) {
+      seed=seed*1103515245u+12345u;
+      data[i]=(uint8_t)(seed>>16);
+    }
+    n+=putRec(buf+n,IHEX_DATA,(uint16_t)addr,data,recsz);
+    addr+=recsz;
+  }
+  n+=putRec(buf+n,IHEX_EOF,0,NULL,0);
+  *len=n;
+  return buf;
+}
+
+/**
+ * @brief Parse buf with decoder fn, print MB/s
+*/
+static int run(const char *name, ihexDecodeFn fn, const char *buf,
+               size_t len, struct tally *t){
+  size_t errpos=0;
+  double t0, t1;
+  memset(t,0,sizeof(*t));
+  ihexDecode=fn;
+  t0=now();
+  int err=ihexParse(buf,len,count,t,&errpos);
+  t1=now();
+  if (err!=IHEX_OK) {
+    fprintf(stderr,"%s: %s at offset %zu\n",name,ihexStrerror(err),
+            errpos);
+    return 1;
+  }
+  printf("%-8s %10.1f MB/s  (%llu records)\n",name,
+         len/(t1-t0)/1e6,(unsigned long long)t->recs);
+  return 0;
+}
+
+int main(int argc, char **argv){
+  size_t mb=256, len=0;
+  int recsz=32;
+  const char *fn=NULL;
+  char *buf;
+  struct tally ref, fast;
+  for (int i=1; i<argc; i++) {
+    if (!strcmp(argv[i],"-m") && i+1<argc) {
+      mb=strtoul(argv[++i],NULL,0);
+    }
+    else if (!strcmp(argv[i],"-r") && i+1<argc) {
+      recsz=atoi(argv[++i]);
+    }
+    else {
+      fn=argv[i];
+    }
+  }
+  if (recsz<1 || recsz>255) {
+    fprintf(stderr,"record size must be 1-255\n");
+    return 2;
+  }
+  buf=fn ? ihexLoad(fn,&len) : generate(mb,(uint8_t)recsz,&len);
+  if (!buf) {
+    perror(fn ? fn : "generate");
+    return 2;
+  }
+  ihexDecodeFn best=ihexDecode;
+  printf("%zu bytes of hex, kernel: %s\n",len,ihexKernel());
+  if (run("scalar",ihexDecodeScalar,buf,len,&ref)
+      || run(ihexKernel(),best,buf,len,&fast)) {
+    free(buf);
+    return 1;
+  }
+  free(buf);
+  if (ref.recs!=fast.recs || ref.sum!=fast.sum) {
+    fprintf(stderr,"mismatch between kernels!\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,44 @@
+/***********************************************************************
+*                              File: sim.h
+*                     Copyright (c): 2019, Dan Purgert
+*                                  : dan@djph.net
+*
+*                           License: GNU GPL v2 only
+*                       Description: Just enough of the AVR side for the
+*                                  : page layer (eeprom.c) to build and
+*                                  : run on the host.
+*
+*                     Prerequisites:
+*                                  : cc (any C99 compiler)
+*                                  : make
+************************************************************************/
+
+/**
+ * @file
+ * @brief Host stand-in for common.h
+ *
+ * Force-included (-include) ahead of eeprom.c, with __HEX_COMMON__
+ * defined so the real common.h (and the AVR headers behind it) is
+ * skipped.  Sizes follow main.h.
+*/
+
+#ifndef __HEX_HOST_SIM__
+  #define __HEX_HOST_SIM__ 1
+  #include <stdint.h>
+
+  #define PROGMEM
+  #define pgm_read_byte(p) (*(const uint8_t *)(p))
+  #define pgm_read_word(p) (*(const uint16_t *)(p))
+
+  /**
+   * @brief As main.h
+  */
+  #define PGSZ 16
+  #define PGMAX 128
+
+  /**
+   * @brief Simulated time (us), moved on by _delay_us() / _delay_ms()
+  */
+  extern uint32_t simus;
+
+#endif
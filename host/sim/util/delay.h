@@ -0,0 +1,23 @@
+/***********************************************************************
+*                              File: delay.h
+*                     Copyright (c): 2019, Dan Purgert
+*                                  : dan@djph.net
+*
+*                           License: GNU GPL v2 only
+*                       Description: Host stand-in for <util/delay.h>.
+*                                  : Delays move the simulated clock on
+*                                  : rather than burning time.
+*
+*                     Prerequisites:
+*                                  : cc (any C99 compiler)
+*                                  : make
+************************************************************************/
+
+#ifndef __HEX_HOST_DELAY__
+  #define __HEX_HOST_DELAY__ 1
+  #include "sim.h"
+
+  #define _delay_us(us) (simus+=(uint32_t)(us))
+  #define _delay_ms(ms) (simus+=(uint32_t)(ms)*1000UL)
+
+#endif
@@ -15,6 +15,8 @@
 ************************************************************************/
 
 #include "main.h"
+#include <util/atomic.h>
+#include <util/delay.h>
 /**
  * @file
  * @brief main.c
@@ -35,12 +37,17 @@ uint8_t rict, //!<Receive input counter (wire / UDR0 -> rxbuf)
         hoct, //!<Hexfile output counter (hxbuf -> ???)
         tict, //!<Transmit input counter (??? -> txbuf)
         toct, //!<Transmit output counter (txbuf -> UDR0 / wire)
-        rc, //!<Received Byte counter (if >0, bytes to process in rxbuf)
-        tc, //!<Transmit Byte counter (if >0, bytes to process in txbuf)
         hxc,//!<Hexfile Byte counter (if >0, bytes to process in hxbuf)
         curst,//!<State Machine current state.
         dtp;//!<Byte counter for EEPROM PageData
 
+/*
+ * Shared with the USART ISRs.  volatile so the wait loops re-read them,
+ * and the main loop side updates them with interrupts off, so an ISR
+ * can't land between the read and the write back.
+*/
+volatile uint8_t rc, //!<Received Byte counter (bytes to process in rxbuf)
+                 tc; //!<Transmit Byte counter (bytes to process in txbuf)
 
 
 /**
@@ -57,6 +64,7 @@ enum data_states {
   DATA,    //!<Data bytes (2*DATASZ characters) 
   CKSUM,   //!<Checksum Verification byte (2 characters)
   END,     //!<EOF Received, return to INITST
+  CMDST,   //!<Command line (see cmd.h), return to INITST
   ERRORST, //!<Something went wrong. Send an alert, wait for reset
 };
 
@@ -70,7 +78,7 @@ enum data_states {
 */
 struct promData {
   uint16_t addr;
-  uint8_t pagedata[PGSZ];
+  uint8_t pagedata[RECSZ];
 } PROM;
 
 /**
@@ -118,8 +126,11 @@ ISR(USART_UDRE_vect){
 
 void init(){
   initUSART(MYUBRR);
+  initEEPROM();
   for (int i = 0; i<BUFSZ; i++) {
     rxbuf[i]=0x00;
+  }
+  for (int i = 0; i<TBUFSZ; i++) {
     txbuf[i]=0x00;
   }
   for (int i = 0; i<HXSZ; i++) {
@@ -133,8 +144,20 @@ void init(){
 void main() {
   init();
   #if DEBUG
-    uint8_t mainmsg[]="Begin.\n";
-    printMsg(mainmsg,7);
+    printMsg_P(PSTR("Begin.\n"));
+  #endif
+  //find out what we're programming before any records turn up
+  uint8_t part=eeProbe();
+  if (part==EENOPART) {
+    printMsg_P(PSTR("No EEPROM.\n"));
+    curst=ERRORST;
+  }
+  #if DEBUG
+    else {
+      printMsg_P(PSTR("part kB/pg: "));
+      printAscii((uint8_t)(eesize>>10));
+      printAscii((uint8_t)eedrv.pgsz);
+    }
   #endif
   while(1) {
     rxbtohex();
@@ -144,7 +167,9 @@ void main() {
 
 void rxbtohex() {
   if (rc>0){
-    --rc;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      --rc;
+    }
     ++hxc;
     if ( hict > (HXSZ-1)) {
       //rollover to start of hex buffer FIFO
@@ -169,9 +194,6 @@ void prohex() {
     
     /*
      * State Machine logic to work through a data record
-     *
-     * TODO: Consider a bigger EEPROM data struct.
-     * TODO: Write out to TWI EEPROM after a record id verified.
     */
     static uint8_t dtsz, //Bytes left in ByteCount segment
                    adrsz, //Bytes left in Address segment
@@ -191,6 +213,10 @@ void prohex() {
           //Carriage Return or Line Feed.  Do nothing
           ;
         }
+        else if (bt==CMDLEAD) {
+          //not a record, a command (see cmd.h)
+          curst=CMDST;
+        }
         else if (bt!=0x3A) {
           //if we're in initstate and the character is NOT a ":", 
           //something is very wrong
@@ -202,7 +228,7 @@ void prohex() {
           //segment (DATASZ state)
           curst=DATASZ;
           //reset EEPROM page
-          for (int i=0;i<PGSZ;i++) {
+          for (int i=0;i<RECSZ;i++) {
             PROM.pagedata[i]=0x00;
           }
           dtsz=2;
@@ -229,9 +255,15 @@ void prohex() {
         }
         else if (dtsz>0){
           dtl|=(tohex(bt));
-          dtl=dtl*2; //double because ihex uses 2B per actual byte
           --dtsz;
-          curst=ADDRLOC;
+          if (dtl>RECSZ) {
+            //won't fit in PROM.pagedata
+            curst=ERRORST;
+          }
+          else {
+            dtl=dtl*2; //double because ihex uses 2B per actual byte
+            curst=ADDRLOC;
+          }
         }
         else {
           //for some reason, we didn't get out of DATASZ
@@ -277,15 +309,13 @@ void prohex() {
           if (rtd==0x00) {
             curst=DATA;
             #ifdef DEBUG
-              uint8_t recmsg[]="todata.";
-              printMsg(recmsg,7);
+              printMsg_P(PSTR("todata."));
               printAscii(rtd);
             #endif
           }
           else if (rtd==0x01) {
             #ifdef DEBUG
-              uint8_t recmsg2[]="toend.";
-              printMsg(recmsg2,6);
+              printMsg_P(PSTR("toend."));
             #endif
             curst=END;
           }
@@ -322,6 +352,13 @@ void prohex() {
         break;
       }  
 
+      case CMDST: {
+        if (cmdByte(bt)) {
+          curst=INITST;
+        }
+        break;
+      }
+
       case CKSUM: {
         //store checksum to buffer, then check data
         if (cksz==2) {
@@ -334,16 +371,24 @@ void prohex() {
           if (cksum(ckb)==0x00) {
             //everything's OK
             #if DEBUG
-              uint8_t ckmsg[]="OK!\n";
-              printMsg(ckmsg,4);
+              printMsg_P(PSTR("OK!\n"));
             #endif
             curst=INITST;
+            //commit the record to every EEPROM in the gang.  This only
+            //waits on a part if it's still busy from the last record.
+            uint8_t eefail=eeCommit(PROM.addr,PROM.pagedata,dtp);
+            if (eefail) {
+              #if DEBUG
+                printMsg_P(PSTR("EEPROM: "));
+                printAscii(eefail);
+              #endif
+              curst=ERRORST;
+            }
           }
           else {
             //checksum failed
             #if DEBUG
-              uint8_t ckmsg2[]="NOK!\n";
-              printMsg(ckmsg2,5);
+              printMsg_P(PSTR("NOK!\n"));
             #endif
             curst=ERRORST;
           }
@@ -351,8 +396,7 @@ void prohex() {
         }
 
         case ERRORST: {
-          uint8_t errout[]="ERROR.\n";
-          printMsg(errout,7);
+          printMsg_P(PSTR("ERROR.\n"));
           printAscii(bt);
           break;
         }
@@ -368,8 +412,29 @@ void prohex() {
           }
           if (rdbuf==0xFF && hxc==0) {
             curst=INITST;
-            uint8_t outmsg[]="EOF.\n";
-            printMsg(outmsg,5);
+            //make sure the last page actually made it.  The CRC only
+            //covers what was committed, so it's no good if it didn't.
+            uint8_t eefail=eeFlush();
+            if (eefail) {
+              printMsg_P(PSTR("EEPROM: "));
+              printAscii(eefail);
+              curst=ERRORST;
+            }
+            else {
+              printMsg_P(PSTR("EOF.\n"));
+              //image summary, compare against host/hexcrc
+              printMsg_P(PSTR("CRC32: "));
+              printLong(eeStatCrc());
+              printMsg_P(PSTR("bytes: "));
+              printLong(eebytes);
+              printMsg_P(PSTR("pages: "));
+              printLong(eepages);
+              #if DEBUG
+                printMsg_P(PSTR("stack free: "));
+                printLong(stackFree());
+              #endif
+            }
+            eeStatClr();
           }
           break;
         }
@@ -393,22 +458,61 @@ void sendout (){
   }
 }
 
+void txDrain(){
+  while (tc>0) {
+    sendout();
+  }
+  //the ISR shuts UDRIE0 off once it finds the FIFO empty
+  while (UCSR0B & (1<<UDRIE0))
+    ;
+  while ( !(UCSR0A & (1<<UDRE0)))
+    ;
+  //and the last frame still has to leave the shift register; 11 bits
+  //is under 10ms down to 1200 baud
+  _delay_ms(10);
+}
+
+/**
+ * @brief Put one byte into the txbuf FIFO
+*/
+static void txPush(uint8_t data){
+  while (tc>(TBUFSZ-1)) {
+    //FIFO is full, let the transmitter drain it rather than
+    //overwriting what hasn't gone out yet
+    sendout();
+  }
+  if (tict>(TBUFSZ-1)) {
+    //rollover to start of TX input buffer FIFO
+    tict=0;
+  }
+  txbuf[tict++]=data;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    tc++;
+  }
+}
+
 /**
  * @brief Copy an arbitrary message into the txbuf FIFO, then enable the 
  * transmitter
 */
 void printMsg(uint8_t *msg, uint8_t len){
   for (int i=0; i<len; i++) {
-    if (tict>(TBUFSZ-1)) {
-      //rollover to start of TX input buffer FIFO
-      tict=0;
-    }
-    txbuf[tict++]=msg[i];
-    tc++;
+    txPush(msg[i]);
   }
   //turn on the transmitter
   sendout();
 }
+
+/**
+ * @brief printMsg(), for a NUL terminated string in flash
+*/
+void printMsg_P(const char *msg){
+  uint8_t c;
+  while ((c=pgm_read_byte(msg++))) {
+    txPush(c);
+  }
+  sendout();
+}
   
 
 
@@ -513,22 +617,19 @@ uint8_t cksum(uint8_t data){
     */
     uint8_t sum=0;
     #if DEBUG
-      uint8_t summsg[]="cksum: ";
-      printMsg(summsg,6);
+      printMsg_P(PSTR("cksum: "));
       printAscii(data);
     #endif 
     for (int i=0; i<dtp; i++) {
       sum=sum+PROM.pagedata[i];
     }
     #if DEBUG
-      uint8_t summsg2[]="datsum: ";
-      printMsg(summsg2,7);
+      printMsg_P(PSTR("datsum: "));
       printAscii(sum);
     #endif 
     sum = sum + data;
     #if DEBUG
-      uint8_t summsg3[]="totsum: ";
-      printMsg(summsg3,7);
+      printMsg_P(PSTR("totsum: "));
       printAscii(sum);
     #endif 
     
@@ -576,3 +677,14 @@ void printAscii (uint8_t data){
   outdat[2]=0x0A;
   printMsg(outdat,3);
 }
+
+void printLong (uint32_t data){
+  uint8_t outdat[9];
+  for (int i=7; i>=0; i--) {
+    uint8_t nib=data&0x0F;
+    outdat[i]=(nib<10) ? ('0'+nib) : ('A'+nib-10);
+    data>>=4;
+  }
+  outdat[8]=0x0A;
+  printMsg(outdat,9);
+}
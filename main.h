@@ -36,25 +36,60 @@
   //TODO: replace the USART hard definitions with a read from EEPROM
   #define BAUD 4800
   #define MYUBRR (F_CPU/16/BAUD-1)
+  /**
+   * @brief TWI clock (Hz)
+   *
+   * 24xx parts are good for 400kHz, but the prescaler-free TWBR formula
+   * needs F_CPU >= 16*SCL, so at 1MHz we're stuck with what we get.
+  */
+  #define SCL 100000UL
+  #if (F_CPU/SCL) > 16
+    #define MYTWBR ((F_CPU/SCL-16)/2)
+  #else
+    #define MYTWBR 0
+  #endif
   /**
    * @brief Rx buffer size
+   *
+   * Sized from the SRAM left over once the messages moved to flash
+   * (see "make mem").  This is the FIFO that soaks up characters while
+   * the main loop sits in an EEPROM write cycle, so the bigger the
+   * better.  The FIFO counters are 8 bit, so it can't go past 255.
   */
-  #define BUFSZ 16
+  #define BUFSZ 176
   /**
    * @brief Tx buffer size
   */
-  #define TBUFSZ BUFSZ*2 
+  #define TBUFSZ 64
   /**
    * @brief EEPROM Page size.
    * 
    * Default assumes 16 byte pages, to fit "hello world" in one page.
+   * Only used until eeProbe() has had a look at the part.
   */
   #define PGSZ 16
   /**
-   * @brief Hex File buffer size.  4x BUFSZ for now, testing may prove a
-   * larger buffer is warranted.
+   * @brief Page buffer size.
+   *
+   * Largest page we'll buffer.  Parts with bigger pages get written a
+   * PGMAX chunk at a time.
+  */
+  #define PGMAX 128
+  /**
+   * @brief Data record buffer size.
+   *
+   * Longest data record we can take.  Most tools emit 16 or 32 bytes
+   * per record.
+  */
+  #define RECSZ 32
+  /**
+   * @brief Hex File buffer size.
+   *
+   * rxbtohex() moves one byte a pass and prohex() takes it straight
+   * back out, so hxbuf never holds more than a byte or so.  Any bigger
+   * is SRAM better spent on rxbuf.
   */ 
-  #define HXSZ BUFSZ*4
+  #define HXSZ 16
   /**
    * @brief FIFO buffer for USART Rx
   */
@@ -82,6 +117,13 @@
    * Enables the transmitter if there's anything in the transmit counter.
   */
   void sendout();
+  /**
+   * @brief Wait for everything in txbuf to go out
+   *
+   * Blocks until the FIFO is empty and the last byte has left the
+   * USART, e.g. before changing the baud rate.
+  */
+  void txDrain();
   /**
    * @brief Receive buffer to Hex Buffer
    *
@@ -99,6 +141,14 @@
   */
   void prohex();
   void printMsg(uint8_t *data, uint8_t len);
+  /**
+   * @brief Print a message from flash
+   *
+   * As printMsg(), but msg is a NUL terminated string in program memory,
+   * so constant messages don't take up SRAM.  Use with PSTR():
+   *  printMsg_P(PSTR("EOF.\n"));
+  */
+  void printMsg_P(const char *msg);
   /**
    * @brief Verify data record checksum
    *
@@ -125,5 +175,12 @@
   uint8_t tohex(uint8_t byte);
   
   void printAscii(uint8_t data);
+  /**
+   * @brief Print a 32-bit value
+   *
+   * Same idea as printAscii(), but 8 hex digits (MSB first), for the
+   * CRC and counters reported at EOF.
+   */
+  void printLong(uint32_t data);
  
 #endif
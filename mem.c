@@ -0,0 +1,59 @@
+/***********************************************************************
+*                              File: mem.c
+*                     Copyright (c): 2019, Dan Purgert
+*                                  : dan@djph.net
+*
+*                           License: GNU GPL v2 only
+*                       Description: SRAM usage tracking.  Paints the
+*                                  : stack at boot, so we can tell how
+*                                  : deep it has ever gone.
+*
+*                     Prerequisites:
+*                                  : avr-gcc >= 4.9.2
+*                                  : avrdude >= 6.3-2 (Debian)
+*                                  : make
+************************************************************************/
+
+/**
+ * @file
+*/
+
+#include "mem.h"
+
+extern uint8_t _end;    //!<End of .bss (from the linker script)
+extern uint8_t __stack; //!<Top of RAM (from the linker script)
+
+void stackPaint() __attribute__ ((naked,used,section(".init1")));
+
+/**
+ * @brief Fill free RAM with STACKCANARY
+ *
+ * Runs from .init1, before the stack pointer is set up, so it has to be
+ * assembler; the compiler would want the stack for locals at -O0.
+*/
+void stackPaint(){
+  __asm volatile (
+    "    ldi r30,lo8(_end)\n"
+    "    ldi r31,hi8(_end)\n"
+    "    ldi r24,%0\n"
+    "    ldi r25,hi8(__stack)\n"
+    "    rjmp 2f\n"
+    "1:  st Z+,r24\n"
+    "2:  cpi r30,lo8(__stack)\n"
+    "    cpc r31,r25\n"
+    "    brlo 1b\n"
+    "    breq 1b\n"
+    :
+    : "i" (STACKCANARY)
+  );
+}
+
+uint16_t stackFree(){
+  const uint8_t *p=&_end;
+  uint16_t n=0;
+  while (p<=&__stack && *p==STACKCANARY) {
+    ++p;
+    ++n;
+  }
+  return n;
+}
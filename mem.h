@@ -0,0 +1,45 @@
+/***********************************************************************
+*                              File: mem.h
+*                     Copyright (c): 2019, Dan Purgert
+*                                  : dan@djph.net
+*
+*                           License: GNU GPL v2 only
+*                       Description: SRAM usage tracking.  Paints the
+*                                  : stack at boot, so we can tell how
+*                                  : deep it has ever gone.
+*
+*                     Prerequisites:
+*                                  : avr-gcc >= 4.9.2
+*                                  : avrdude >= 6.3-2 (Debian)
+*                                  : make
+************************************************************************/
+
+/**
+ * @file
+ * @brief SRAM usage header
+ *
+ * Everything between the end of .bss and the top of RAM is filled with
+ * STACKCANARY before main() runs (see mem.c, it hooks .init1).  The
+ * stack grows down into that, so counting the canary bytes still left
+ * at the bottom gives the least free RAM there has ever been.  The
+ * static side (.data / .bss) is reported by "make mem".
+*/
+
+#ifndef __HEX_MEM__
+  #define __HEX_MEM__ 1
+  #include "common.h"
+
+  /**
+   * @brief Stack paint value
+  */
+  #define STACKCANARY 0xC5
+
+  /**
+   * @brief Free RAM low water mark
+   *
+   * Bytes between the end of .bss and the deepest the stack has been
+   * since reset.
+  */
+  uint16_t stackFree();
+
+#endif
@@ -0,0 +1,39 @@
+/***********************************************************************
+*                              File: spi.c
+*                     Copyright (c): 2019, Dan Purgert
+*                                  : dan@djph.net
+*
+*                           License: GNU GPL v2 only
+*                       Description: Hardware SPI master routines for
+*                                  : talking to 25xx EEPROMs / serial
+*                                  : flash.  Polled, not interrupt
+*                                  : driven.
+*
+*                     Prerequisites:
+*                                  : avr-gcc >= 4.9.2
+*                                  : avrdude >= 6.3-2 (Debian)
+*                                  : make
+************************************************************************/
+
+/**
+ * @file
+*/
+
+#include "spi.h"
+
+void initSPI(){
+  //MOSI, SCK and SS out, MISO in.  MISO gets the pull-up, so a part
+  //that isn't there reads 0xFF rather than whatever the pin floats to.
+  DDRB |= (1<<PB3)|(1<<PB5)|(1<<PB2);
+  DDRB &= ~(1<<PB4);
+  PORTB |= (1<<PB4);
+  SPCR = (1<<SPE)|(1<<MSTR);
+  SPSR = (1<<SPI2X);
+}
+
+uint8_t spiXfer(uint8_t data){
+  SPDR = data;
+  while ( !(SPSR & (1<<SPIF)))
+    ;
+  return SPDR;
+}
@@ -0,0 +1,44 @@
+/***********************************************************************
+*                              File: spi.h
+*                     Copyright (c): 2019, Dan Purgert
+*                                  : dan@djph.net
+*
+*                           License: GNU GPL v2 only
+*                       Description: Hardware SPI master routines for
+*                                  : talking to 25xx EEPROMs / serial
+*                                  : flash.  Polled, not interrupt
+*                                  : driven.
+*
+*                     Prerequisites:
+*                                  : avr-gcc >= 4.9.2
+*                                  : avrdude >= 6.3-2 (Debian)
+*                                  : make
+************************************************************************/
+
+/**
+ * @file
+ * @brief SPI control header
+ *
+ * Header file for the SPI master.  Chip selects are up to whoever is
+ * using the bus (see spiee.c), this just clocks bytes.
+*/
+
+#ifndef __HEX_SPI__
+  #define __HEX_SPI__ 1
+  #include "common.h"
+
+  /**
+   * @brief Initialize SPI
+   * Master, mode 0, SCK = F_CPU/2 (the fastest the hardware goes).
+   * SS (PB2) is made an output, otherwise pulling it low would knock
+   * us out of master mode.  MISO (PB4) is pulled up, so nothing on the
+   * other end reads as 0xFF.
+  */
+  void initSPI();
+  /**
+   * @brief Exchange a byte
+   * Clocks data out on MOSI, and returns what came back on MISO.
+  */
+  uint8_t spiXfer(uint8_t data);
+
+#endif
@@ -0,0 +1,192 @@
+/***********************************************************************
+*                              File: spiee.c
+*                     Copyright (c): 2019, Dan Purgert
+*                                  : dan@djph.net
+*
+*                           License: GNU GPL v2 only
+*                       Description: Storage backend for 25xx SPI
+*                                  : EEPROMs and serial NOR flash.
+*
+*                     Prerequisites:
+*                                  : avr-gcc >= 4.9.2
+*                                  : avrdude >= 6.3-2 (Debian)
+*                                  : make
+************************************************************************/
+
+/**
+ * @file
+ * @brief 25xx SPI EEPROM / serial flash backend
+ *
+ * Device number n is the part whose chip select is wired to PCn (active
+ * low).  PC4/PC5 are free since there's no TWI in an SPI build, so up to
+ * six parts can be ganged.  The 25xx EEPROMs and the common NOR flashes
+ * share a command set (WREN / WRITE / READ / RDSR), so the only real
+ * differences are page size and the width of the address.
+ *
+ * Flash has to be erased before it's written, which is left to the
+ * caller (eedrv.erase()).  Nor can it be probed by writing to it, so a
+ * flash build (SPIADR 3) hands eeProbe() its JEDEC ID instead.
+ *
+ * SPIADR, SPIPGSZ and SPICE are set from the makefile, so a NOR flash
+ * build is
+ *  make STORE=spi DEFS="-DSPIADR=3 -DSPIPGSZ=256"
+ * and a 25xx EEPROM that does have CE (25LC512, say) can use it with
+ * -DSPICE=1.
+ *
+ * Page layer addresses are 16 bit (hex records without 02 / 04), so
+ * the top address byte is always 0 and only the first 64k of a bigger
+ * flash is used.
+*/
+
+#include "eeprom.h"
+
+/**
+ * @brief Page size.  64 bytes suits a 25LC256, NOR flash wants 256.
+*/
+#ifndef SPIPGSZ
+  #define SPIPGSZ 64
+#endif
+/**
+ * @brief Address bytes.  2 for 25xx EEPROMs, 3 for NOR flash.
+*/
+#ifndef SPIADR
+  #define SPIADR 2
+#endif
+/**
+ * @brief Chip erase (CE) is there.  Every NOR flash has it, only some
+ * 25xx EEPROMs do, and those without just ignore it.
+*/
+#ifndef SPICE
+  #define SPICE (SPIADR > 2)
+#endif
+
+#define SPI_WREN  0x06 //!<Write enable
+#define SPI_RDSR  0x05 //!<Read status register
+#define SPI_READ  0x03 //!<Read data
+#define SPI_WRITE 0x02 //!<Write (page program)
+#define SPI_CE    0xC7 //!<Chip erase
+#define SPI_RDID  0x9F //!<Read JEDEC ID (flash only)
+#define SPI_WIP   0x01 //!<Status register, write in progress
+
+static void spieeSel(uint8_t dev){
+  PORTC &= ~(1<<dev);
+}
+
+static void spieeDesel(uint8_t dev){
+  PORTC |= (1<<dev);
+}
+
+/**
+ * @brief Select a part and send a command, plus address
+*/
+static void spieeCmd(uint8_t dev, uint8_t cmd, uint16_t addr){
+  spieeSel(dev);
+  spiXfer(cmd);
+  #if SPIADR > 2
+    //only the first 64k, see above
+    spiXfer(0x00);
+  #endif
+  spiXfer((uint8_t)(addr>>8));
+  spiXfer((uint8_t)addr);
+}
+
+/**
+ * @brief Set the write enable latch, needed before every write / erase
+*/
+static void spieeWren(uint8_t dev){
+  spieeSel(dev);
+  spiXfer(SPI_WREN);
+  spieeDesel(dev);
+}
+
+static void spieeInit(){
+  //all chip selects high (idle) before they become outputs
+  PORTC |= (EEGANG & 0x3F);
+  DDRC |= (EEGANG & 0x3F);
+  initSPI();
+}
+
+/**
+ * @brief Poll the status register
+ *
+ * Nothing on the bus acks anything, so this is also how a missing part
+ * is found: MISO is pulled up (initSPI()), so it reads 0xFF, WIP never
+ * clears, and eeWait() times out.
+*/
+static uint8_t spieeBusy(uint8_t dev){
+  uint8_t st;
+  spieeSel(dev);
+  spiXfer(SPI_RDSR);
+  st=spiXfer(0xFF);
+  spieeDesel(dev);
+  return (st & SPI_WIP);
+}
+
+static uint8_t spieeWrite(uint8_t dev, uint16_t addr, uint8_t *data,
+                          uint8_t len){
+  spieeWren(dev);
+  spieeCmd(dev,SPI_WRITE,addr);
+  for (uint8_t i=0; i<len; i++) {
+    spiXfer(data[i]);
+  }
+  //write cycle starts when CS goes high
+  spieeDesel(dev);
+  return 1;
+}
+
+static uint8_t spieeRead(uint8_t dev, uint16_t addr, uint8_t *data,
+                         uint8_t len){
+  spieeCmd(dev,SPI_READ,addr);
+  for (uint8_t i=0; i<len; i++) {
+    data[i]=spiXfer(0xFF);
+  }
+  spieeDesel(dev);
+  return 1;
+}
+
+static uint8_t spieeErase(uint8_t dev){
+  #if SPICE
+    spieeWren(dev);
+    spieeSel(dev);
+    spiXfer(SPI_CE);
+    spieeDesel(dev);
+    return 1;
+  #else
+    //no CE, eeErase() fills the part with 0xFF instead
+    return 0;
+  #endif
+}
+
+#if SPIADR > 2
+/**
+ * @brief JEDEC ID: manufacturer, memory type, log2(capacity)
+*/
+static uint8_t spieeIdent(uint8_t dev){
+  uint8_t mfr, cap;
+  spieeSel(dev);
+  spiXfer(SPI_RDID);
+  mfr=spiXfer(0xFF);
+  spiXfer(0xFF);
+  cap=spiXfer(0xFF);
+  spieeDesel(dev);
+  //MISO stuck high or low, there's nothing there
+  if (mfr==0x00 || mfr==0xFF) {
+    return 0;
+  }
+  return cap;
+}
+#endif
+
+struct eeDrv eedrv = {
+  SPIPGSZ,
+  spieeInit,
+  spieeBusy,
+  spieeWrite,
+  spieeRead,
+  spieeErase,
+  #if SPIADR > 2
+    spieeIdent,
+  #else
+    0, //25xx EEPROMs have no ID, eeProbe() measures the part
+  #endif
+};
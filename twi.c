@@ -0,0 +1,74 @@
+/***********************************************************************
+*                              File: twi.c
+*                     Copyright (c): 2019, Dan Purgert
+*                                  : dan@djph.net
+*
+*                           License: GNU GPL v2 only
+*                       Description: TWI (I2C) master routines for
+*                                  : talking to the EEPROM(s).  Bus
+*                                  : operations are polled, not
+*                                  : interrupt driven.
+*
+*                     Prerequisites:
+*                                  : avr-gcc >= 4.9.2
+*                                  : avrdude >= 6.3-2 (Debian)
+*                                  : make
+************************************************************************/
+
+/**
+ * @file
+*/
+
+#include "twi.h"
+#include <util/twi.h>
+
+/**
+ * @brief Wait for the TWI hardware to finish, return the bus status
+*/
+static uint8_t twiWait(){
+  while ( !(TWCR & (1<<TWINT)))
+    ;
+  return TW_STATUS;
+}
+
+void initTWI(uint8_t twbr){
+  TWSR = 0x00;
+  TWBR = twbr;
+  TWCR = (1<<TWEN);
+}
+
+uint8_t twiStart(uint8_t sla){
+  uint8_t st;
+  TWCR = (1<<TWINT)|(1<<TWSTA)|(1<<TWEN);
+  st = twiWait();
+  if (st!=TW_START && st!=TW_REP_START) {
+    return 0;
+  }
+  TWDR = sla;
+  TWCR = (1<<TWINT)|(1<<TWEN);
+  st = twiWait();
+  return (st==TW_MT_SLA_ACK || st==TW_MR_SLA_ACK);
+}
+
+uint8_t twiWrite(uint8_t data){
+  TWDR = data;
+  TWCR = (1<<TWINT)|(1<<TWEN);
+  return (twiWait()==TW_MT_DATA_ACK);
+}
+
+uint8_t twiRead(uint8_t ack){
+  if (ack) {
+    TWCR = (1<<TWINT)|(1<<TWEN)|(1<<TWEA);
+  }
+  else {
+    TWCR = (1<<TWINT)|(1<<TWEN);
+  }
+  twiWait();
+  return TWDR;
+}
+
+void twiStop(){
+  TWCR = (1<<TWINT)|(1<<TWSTO)|(1<<TWEN);
+  while (TWCR & (1<<TWSTO))
+    ;
+}
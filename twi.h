@@ -0,0 +1,65 @@
+/***********************************************************************
+*                              File: twi.h
+*                     Copyright (c): 2019, Dan Purgert
+*                                  : dan@djph.net
+*
+*                           License: GNU GPL v2 only
+*                       Description: TWI (I2C) master routines for
+*                                  : talking to the EEPROM(s).  Bus
+*                                  : operations are polled, not
+*                                  : interrupt driven.
+*
+*                     Prerequisites:
+*                                  : avr-gcc >= 4.9.2
+*                                  : avrdude >= 6.3-2 (Debian)
+*                                  : make
+************************************************************************/
+
+/**
+ * @file
+ * @brief TWI control header
+ *
+ * Header file for the TWI master.  Each call blocks until the hardware
+ * has finished the requested bus operation, and reports back whether
+ * the slave acknowledged it.  Higher level EEPROM handling lives in
+ * eeprom.c.
+*/
+
+#ifndef __HEX_TWI__
+  #define __HEX_TWI__ 1
+  #include "common.h"
+
+  /**
+   * @brief Initialize TWI
+   * Set the bitrate register and enable the TWI module.  Prescaler is
+   * left at 1, so SCL = F_CPU / (16 + 2*twbr).
+  */
+  void initTWI(uint8_t twbr);
+  /**
+   * @brief Send START and slave address
+   *
+   * Issues a (repeated) START condition followed by the address byte
+   * sla (7-bit address shifted left, R/W in bit 0).  Returns 1 if the
+   * slave ACKed its address, 0 otherwise.  A 24xx part in its internal
+   * write cycle will NAK, which is what ACK polling relies on.
+  */
+  uint8_t twiStart(uint8_t sla);
+  /**
+   * @brief Transmit a byte
+   * Returns 1 if the slave ACKed the byte, 0 otherwise.
+  */
+  uint8_t twiWrite(uint8_t data);
+  /**
+   * @brief Receive a byte
+   * Reads one byte from the slave, answering with ACK if ack is
+   * non-zero (more bytes wanted) or NAK on the last byte.
+  */
+  uint8_t twiRead(uint8_t ack);
+  /**
+   * @brief Send STOP
+   * Releases the bus.  Waits for the STOP condition to go out, so the
+   * next twiStart() can't trample it.
+  */
+  void twiStop();
+
+#endif
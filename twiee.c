@@ -0,0 +1,100 @@
+/***********************************************************************
+*                              File: twiee.c
+*                     Copyright (c): 2019, Dan Purgert
+*                                  : dan@djph.net
+*
+*                           License: GNU GPL v2 only
+*                       Description: Storage backend for 24xx TWI
+*                                  : EEPROMs (two address byte parts,
+*                                  : 24C32 and up).
+*
+*                     Prerequisites:
+*                                  : avr-gcc >= 4.9.2
+*                                  : avrdude >= 6.3-2 (Debian)
+*                                  : make
+************************************************************************/
+
+/**
+ * @file
+ * @brief 24xx TWI EEPROM backend
+ *
+ * Device number n is the part strapped to A2..A0 = n.  A part in its
+ * write cycle NAKs its address, so busy() is a single ACK poll.
+*/
+
+#include "eeprom.h"
+#include <util/twi.h>
+
+/**
+ * @brief 7-bit TWI base address of a 24xx part (A2..A0 = 0)
+*/
+#define EEBASE 0x50
+
+/**
+ * @brief TWI address byte for part dev
+*/
+static uint8_t twieeSla(uint8_t dev, uint8_t rw){
+  return ((EEBASE|(dev&0x07))<<1)|rw;
+}
+
+/**
+ * @brief Address a part and send the memory address word
+ * Leaves the bus held (no STOP) for the data phase.
+*/
+static uint8_t twieeAddr(uint8_t dev, uint16_t addr){
+  if (!twiStart(twieeSla(dev,TW_WRITE))) {
+    return 0;
+  }
+  if (!twiWrite((uint8_t)(addr>>8))) {
+    return 0;
+  }
+  return twiWrite((uint8_t)addr);
+}
+
+static void twieeInit(){
+  initTWI(MYTWBR);
+}
+
+static uint8_t twieeBusy(uint8_t dev){
+  uint8_t ok=twiStart(twieeSla(dev,TW_WRITE));
+  twiStop();
+  return !ok;
+}
+
+static uint8_t twieeWrite(uint8_t dev, uint16_t addr, uint8_t *data,
+                          uint8_t len){
+  uint8_t ok=twieeAddr(dev,addr);
+  for (uint8_t i=0; ok && i<len; i++) {
+    ok=twiWrite(data[i]);
+  }
+  twiStop();
+  return ok;
+}
+
+static uint8_t twieeRead(uint8_t dev, uint16_t addr, uint8_t *data,
+                         uint8_t len){
+  uint8_t ok=twieeAddr(dev,addr);
+  if (ok) {
+    ok=twiStart(twieeSla(dev,TW_READ));
+  }
+  for (uint8_t i=0; ok && i<len; i++) {
+    data[i]=twiRead(i<(len-1));
+  }
+  twiStop();
+  return ok;
+}
+
+static uint8_t twieeErase(uint8_t dev){
+  //24xx parts don't have one, they have to be written 0xFF
+  return 0;
+}
+
+struct eeDrv eedrv = {
+  PGSZ,
+  twieeInit,
+  twieeBusy,
+  twieeWrite,
+  twieeRead,
+  twieeErase,
+  0, //no ID, eeProbe() measures the part
+};
@@ -20,14 +20,12 @@
 
 #include "usart.h"
 void initUSART(uint16_t ubrr){
-  //UBRR0H = (uint8_t)(ubrr>>8);
-  //UBRR0L = (uint8_t) ubrr;
   /**
-   * To facilitate testing, UBRR0H/UBRR0L are hardcoded to 4800 baud.
-   * this needs to be changed.
+   * MYUBRR works out to 0x0C (4800 baud at 1MHz), the old hardcoded
+   * value.  The '!B' command can change it on the fly.
   */
-  UBRR0H = 0x00;
-  UBRR0L = 0x0C;
+  UBRR0H = (uint8_t)(ubrr>>8);
+  UBRR0L = (uint8_t) ubrr;
   /**
    * @brief Clear control register UCSR0A
    * Clear UCSR0A - handles interrupts, frame errors,